@@ -3,12 +3,19 @@
 #ifndef DOTMARK_H
 #define DOTMARK_H
 
+#include <benchmark/scheduler.h>
 #include <benchmark/solvers.h>
 
+#include <algorithm>
+#include <chrono>
 #include <filesystem>
 #include <fstream>
 #include <iostream>
 #include <map>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <optional>
 #include <regex>
 #include <set>
 #include <string>
@@ -27,15 +34,15 @@ class DOTmark {
         _filename_pattern(R"(data(\d+)_1(\d+)\.csv)")  // Matches pattern like
                                                        // "data512_1006.csv") {}
   {
-    fs::path output_directory = fs::path(_data_path).parent_path() / "Results";
-    if (!fs::exists(output_directory)) fs::create_directory(output_directory);
-    std::cout << "Results are stored into " << output_directory << std::endl;
-    _output_file =
-        std::ofstream(output_directory / "benchmark_output.txt", std::ios::app);
+    _output_directory = fs::path(_data_path).parent_path() / "Results";
+    if (!fs::exists(_output_directory)) fs::create_directory(_output_directory);
+    std::cout << "Results are stored into " << _output_directory << std::endl;
+    _output_file = std::ofstream(_output_directory / "benchmark_output.txt",
+                                 std::ios::app);
     _output_file_detailed = std::ofstream(
-        output_directory / "benchmark_output_detailed.txt", std::ios::app);
+        _output_directory / "benchmark_output_detailed.txt", std::ios::app);
     _statistics_file = std::ofstream(
-        output_directory / "benchmark_statistics_gridOT.txt", std::ios::app);
+        _output_directory / "benchmark_statistics_gridOT.txt", std::ios::app);
 
     // Open the file stream in append mode to ensure we can add to it
     if (!_output_file.is_open() || !_output_file_detailed.is_open() ||
@@ -82,8 +89,10 @@ class DOTmark {
     }
   }
 
-  // Run benchmark for all pairs of images within each class
-  void runBenchmark() {
+  // Run benchmark for all pairs of images within each class, solving the
+  // pairs in parallel on num_threads threads. The output files are written
+  // in the same order as by a sequential run.
+  void runBenchmark(const int num_threads = 1) {
     if (_dim)
       printOutput("%d runs per pair; resolution = %d\n", _runs, _dim);
     else
@@ -92,37 +101,142 @@ class DOTmark {
                 "obj", "time [ms]");
     for (int i = 0; i < 55; ++i) printOutput("-");
     printOutput("\n");
+
+    // Pairs in the order of the output, grouped by resolution and class
+    std::vector<Pair> pairs;
+    std::vector<Group> groups;
     for (const int res : _resolutions) {
       for (const auto& [class_name, class_resolutions] : _class_images) {
         auto it = class_resolutions.find(res);
         if (it != class_resolutions.end()) {
           const auto& images = it->second;
-          long double t = 0, t_ref = 0;
-          bool optimal = true, optimal_ref = true;
-          int n = 0;
           for (size_t i = 0; i < images.size(); ++i) {
             for (size_t j = 0; j < images.size(); ++j) {
               if (i == j) continue;
-
-              auto [opt, t_ij, opt_ref, t_ref_ij] =
-                  benchmarkPair(class_name, res, images[i], images[j]);
-              t += t_ij;
-              t_ref += t_ref_ij;
-              optimal &= opt;
-              optimal_ref &= opt_ref;
-              ++n;
+              pairs.push_back({res, &class_name, &images[i], &images[j]});
             }
           }
-          printOutput("%7d%17s%6s%4d %9s%11.1f   GridOT\n", res, class_name, "",
-                      optimal, "", t / n);
-          printOutput("%7d%17s%6s%4d %9s%11.1f   MultiScaleOT\n", res,
-                      class_name, "", optimal_ref, "", t_ref / n);
+          groups.push_back({res, &class_name, int(pairs.size())});
+        }
+      }
+    }
+
+    // Largest resolutions first, such that the small pairs fill the gaps at
+    // the end. A single thread keeps the order of the output.
+    std::vector<int> order(pairs.size());
+    std::iota(order.begin(), order.end(), 0);
+    if (num_threads > 1) {
+      std::stable_sort(order.begin(), order.end(), [&](int k, int l) {
+        return pairs[k].resolution > pairs[l].resolution;
+      });
+    }
+
+    // Each thread reuses its solver context while the resolution stays
+    std::vector<std::unique_ptr<GridContext>> contexts(num_threads);
+    std::vector<std::optional<PairResult>> results(pairs.size());
+    std::mutex mutex;
+    int next_pair = 0, next_group = 0;
+    const auto start = std::chrono::steady_clock::now();
+    auto times = runWorkStealing(order, num_threads, [&](int t, int k) {
+      const Pair& pair = pairs[k];
+      std::unique_ptr<GridContext>& context = contexts[t];
+      if (!context || context->resolution != pair.resolution)
+        context = std::make_unique<GridContext>(pair.resolution);
+      PairResult result =
+          benchmarkPair(*context, pair.resolution, *pair.image1, *pair.image2);
+
+      std::lock_guard<std::mutex> lock(mutex);
+      results[k] = std::move(result);
+      printReady(results, groups, next_pair, next_group);
+    });
+    printReady(results, groups, next_pair, next_group);
+    const double wall_ms = std::chrono::duration<double, std::milli>(
+                               std::chrono::steady_clock::now() - start)
+                               .count();
+
+    // Cpu and wall time of each thread, on the console only
+    double cpu_ms = 0;
+    fmt::printf("\n%7s%7s%11s%11s\n", "thread", "pairs", "cpu [s]",
+                "wall [s]");
+    for (int t = 0; t < num_threads; ++t) {
+      fmt::printf("%7d%7d%11.1f%11.1f\n", t, times[t].tasks,
+                  times[t].cpu_ms / 1000, times[t].wall_ms / 1000);
+      cpu_ms += times[t].cpu_ms;
+    }
+    fmt::printf("%7s%7d%11.1f%11.1f\n", "total", int(pairs.size()),
+                cpu_ms / 1000, wall_ms / 1000);
+  }
+
+  // Computes the distance matrix of the images of each class and resolution,
+  // solving each unordered pair once with num_threads threads. The matrices
+  // are written to distance_matrix_<resolution>_<class>.txt, whose first line
+  // holds the image numbers of the rows and columns.
+  void runDistanceMatrix(const int num_threads = 1) {
+    fmt::printf("%7s%17s%7s%4s%11s\n", "dim", "class", "images", "opt",
+                "wall [ms]");
+    for (int i = 0; i < 46; ++i) fmt::printf("-");
+    fmt::printf("\n");
+    for (const int res : _resolutions) {
+      for (const auto& [class_name, class_resolutions] : _class_images) {
+        auto it = class_resolutions.find(res);
+        if (it == class_resolutions.end()) continue;
+        const auto& images = it->second;
+
+        std::vector<ValueVector> marginals;
+        for (const std::string& image : images)
+          marginals.push_back(loadMarginal(image));
+        DistanceMatrix matrix({res, res}, {marginals.begin(), marginals.end()});
+        matrix.threads(num_threads);
+
+        const auto start = std::chrono::steady_clock::now();
+        const bool optimal =
+            matrix.run() == DistanceMatrix::Solver::NetSimplex::OPTIMAL;
+        const double wall_ms = std::chrono::duration<double, std::milli>(
+                                   std::chrono::steady_clock::now() - start)
+                                   .count();
+        fmt::printf("%7d%17s%7d%4d%11.1f\n", res, class_name,
+                    int(images.size()), optimal, wall_ms);
+
+        std::ofstream file(_output_directory /
+                           ("distance_matrix_" + std::to_string(res) + "_" +
+                            class_name + ".txt"));
+        for (const std::string& image : images)
+          fmt::printf(file, " %d", imageNumber(image));
+        fmt::printf(file, "\n");
+        for (int i = 0; i < matrix.size(); ++i) {
+          for (int j = 0; j < matrix.size(); ++j)
+            fmt::printf(file, " %d", matrix.distance(i, j));
+          fmt::printf(file, "\n");
         }
       }
     }
   }
 
  private:
+  // Pair of images of a class, the strings are owned by _class_images
+  struct Pair {
+    int resolution;
+    const std::string* class_name;
+    const std::string* image1;
+    const std::string* image2;
+  };
+
+  // Pairs of one resolution and class, which end before pair end
+  struct Group {
+    int resolution;
+    const std::string* class_name;
+    int end;
+  };
+
+  // Results of the runs on a pair
+  struct PairResult {
+    int i, j;  // Image numbers
+    bool optimal, optimal_ref;
+    TotalCost obj, obj_ref;
+    long double t, t_ref;  // Average time per run in ms
+    std::vector<Statistics> statistics;
+  };
+
   const std::string _data_path;  // Path to DOTmark data
   const int _runs;
   const int _dim;
@@ -133,6 +247,7 @@ class DOTmark {
   std::ofstream _output_file;
   std::ofstream _output_file_detailed;
   std::ofstream _statistics_file;
+  fs::path _output_directory;
 
   // Helper function to print to both the console and the file
   template <typename... Args>
@@ -163,60 +278,127 @@ class DOTmark {
     return data;
   }
 
-  // Reads two csv files as signed supplies in a contiguous vector
-  ValueVector loadSupply(const std::string& source, const std::string& target) {
-    ValueVector supply = loadCSV(source);
-    ValueVector demand = loadCSV(target);
+  // Reads two csv files as the supply of the source and the demand of the
+  // target, the solvers view them without further copies
+  std::pair<ValueVector, ValueVector> loadMarginals(const std::string& source,
+                                                    const std::string& target) {
+    return {loadMarginal(source), loadMarginal(target)};
+  }
 
-    // Increment supply and demand by one to avoid zero entries 
-    // which Schmitzer cannot handle
-    for (auto& v : supply) ++v;
-    for (auto& v : demand) ++v;
+  // Reads a csv file as a marginal
+  ValueVector loadMarginal(const std::string& image) {
+    ValueVector marginal = loadCSV(image);
 
-    ValueVector signed_supply = supply;
-    for (Value v : demand) signed_supply.push_back(-v);
+    // Increment by one to avoid zero entries which Schmitzer cannot handle
+    for (auto& v : marginal) ++v;
+    return marginal;
+  }
 
-    return signed_supply;
+  // Number of the image in its class
+  int imageNumber(const std::string& image) {
+    std::smatch match;
+    const std::string name = fs::path(image).filename().string();
+    std::regex_match(name, match, _filename_pattern);
+    return std::stoi(match[2].str());
   }
 
+  // Prints one line per level: counts, phase times in ms, and densities
   void print_statistics(const int resolution, const std::string& class_name,
                         const int i, const int j,
-                        const std::vector<std::vector<double>>& densities) {
+                        const std::vector<Statistics>& statistics) {
     fmt::printf(_statistics_file, "%s (%dx%d): %d->%d:\n", class_name,
                 resolution, resolution, i, j);
-    for (const auto& level : densities) {
-      for (const auto& density : level) {
-        fmt::printf(_statistics_file, "%9.3g ", density);
+    fmt::printf(_statistics_file,
+                "%9s%9s%11s%4s%4s%9s%9s%9s%9s%9s%9s%9s%9s  %s\n", "pivots",
+                "degen", "searched", "reb", "upd", "arcs", "pricing", "tree",
+                "pot", "shield", "refine", "wall", "cpu", "densities");
+    for (const Statistics& level : statistics) {
+      fmt::printf(_statistics_file, "%9d%9d%11d%4d%4d%9d", level.pivots,
+                  level.degenerate_pivots, level.search_length,
+                  level.shield_rebuilds, level.shield_updates,
+                  level.arcs_added);
+      for (const double t : level.phase_ms)
+        fmt::printf(_statistics_file, "%9.1f", t);
+      fmt::printf(_statistics_file, "%9.1f%9.1f ", level.wall_ms,
+                  level.cpu_ms);
+      for (const double density : level.densities) {
+        fmt::printf(_statistics_file, " %9.3g", density);
       }
       fmt::printf(_statistics_file, "\n");
     }
     _statistics_file.flush();
   }
 
+  // Prints the results of the pairs from next_pair on, as far as they are
+  // ready, and the summaries of the groups they complete
+  void printReady(const std::vector<std::optional<PairResult>>& results,
+                  const std::vector<Group>& groups, int& next_pair,
+                  int& next_group) {
+    for (;;) {
+      for (; next_group < int(groups.size()) &&
+             groups[next_group].end == next_pair;
+           ++next_group) {
+        const Group& group = groups[next_group];
+        const int begin = next_group ? groups[next_group - 1].end : 0;
+        long double t = 0, t_ref = 0;
+        bool optimal = true, optimal_ref = true;
+        for (int k = begin; k < group.end; ++k) {
+          t += results[k]->t;
+          t_ref += results[k]->t_ref;
+          optimal &= results[k]->optimal;
+          optimal_ref &= results[k]->optimal_ref;
+        }
+        const int n = group.end - begin;
+        printOutput("%7d%17s%6s%4d %9s%11.1f   GridOT\n", group.resolution,
+                    *group.class_name, "", optimal, "", t / n);
+        printOutput("%7d%17s%6s%4d %9s%11.1f   MultiScaleOT\n",
+                    group.resolution, *group.class_name, "", optimal_ref, "",
+                    t_ref / n);
+      }
+      if (next_pair == int(results.size()) || !results[next_pair]) return;
+
+      const Group& group = groups[next_group];
+      const PairResult& result = *results[next_pair];
+      fmt::printf(_output_file_detailed,
+                  "%7d%17s%3d%3d%4d %9.3g%11.1f   GridOT\n", group.resolution,
+                  *group.class_name, result.i, result.j, result.optimal,
+                  (double)result.obj, result.t);
+      fmt::printf(_output_file_detailed,
+                  "%7d%17s%3d%3d%4d %9.3g%11.1f   MultiScaleOT\n",
+                  group.resolution, *group.class_name, result.i, result.j,
+                  result.optimal_ref, (double)result.obj_ref, result.t_ref);
+      _output_file_detailed.flush();
+      print_statistics(group.resolution, *group.class_name, result.i,
+                       result.j, result.statistics);
+      ++next_pair;
+    }
+  }
+
   // Benchmark function to run OT on an image pair
-  std::tuple<bool, long double, bool, long double> benchmarkPair(
-      const std::string& class_name, int resolution, const std::string& image1,
-      const std::string& image2) {
-    ValueVector supply = loadSupply(image1, image2);
-    assert(supply.size() == 2 * resolution * resolution);
+  PairResult benchmarkPair(GridContext& context, int resolution,
+                           const std::string& image1,
+                           const std::string& image2) {
+    const auto [supply, demand] = loadMarginals(image1, image2);
+    assert(supply.size() == resolution * resolution);
+    assert(demand.size() == resolution * resolution);
 
     // Measure time taken by the solver
     long double t = 0, t_ref = 0;
     TotalCost obj = 0, obj_ref = 0;
     bool optimal = true, optimal_ref = true;
-    std::vector<std::vector<double>> densities;
+    std::vector<Statistics> statistics;
     for (int it = 0; it < _runs; ++it) {
       std::array<int, 2> dim = {resolution, resolution};
-      Graph graph(dim, dim, supply);
-      auto [res, new_densities] = gridSolver(graph);
+      auto [res, new_statistics] = gridSolver(context, supply, demand);
       t += res.t_ms;
       optimal &= res.return_value == GridSolver::NetSimplex::OPTIMAL;
       if (obj) assert(obj == res.objective_value);
       obj = res.objective_value;
-      densities = new_densities;
+      statistics = new_statistics;
 
-      Results resRef = schmitzerMultiScale(
-          dim.data(), supply, lemon::utils::hierarchicalDepth(dim, dim, 2) + 1);
+      Results resRef =
+          schmitzerMultiScale(dim.data(), supply, demand,
+                              lemon::utils::hierarchicalDepth(dim, dim, 2) + 1);
       t_ref += resRef.t_ms;
       optimal_ref &= resRef.return_value;
       if (obj_ref) assert(obj_ref == resRef.objective_value);
@@ -226,27 +408,9 @@ class DOTmark {
       fmt::printf("Integer overflow!!!\n");
     }
 
-    // get image number
-    int i, j;
-    std::smatch match;
-    std::filesystem::path path1(image1);
-    std::filesystem::path path2(image2);
-    std::string name1 = path1.filename().string();
-    std::string name2 = path2.filename().string();
-    std::regex_match(name1, match, _filename_pattern);
-    i = std::stoi(match[2].str());
-    std::regex_match(name2, match, _filename_pattern);
-    j = std::stoi(match[2].str());
-
-    fmt::printf(_output_file_detailed,
-                "%7d%17s%3d%3d%4d %9.3g%11.1f   GridOT\n", resolution,
-                class_name, i, j, optimal, (double)obj, t / _runs);
-    fmt::printf(_output_file_detailed,
-                "%7d%17s%3d%3d%4d %9.3g%11.1f   MultiScaleOT\n", resolution,
-                class_name, i, j, optimal_ref, (double)obj_ref, t_ref / _runs);
-    _output_file_detailed.flush();
-    print_statistics(resolution, class_name, i, j, densities);
-    return std::make_tuple(optimal, t / _runs, optimal_ref, t_ref / _runs);
+    const int i = imageNumber(image1), j = imageNumber(image2);
+    return {i, j, optimal, optimal_ref, obj, obj_ref, t / _runs, t_ref / _runs,
+            std::move(statistics)};
   }
 };
 
@@ -0,0 +1,129 @@
+// pricing_layout.cpp
+//
+// Microbenchmark of the arc layout in pricing. It solves a random instance,
+// takes the arcs of the finest shield with the optimal potentials, and then
+// times full pricing sweeps over
+//  - the parallel arc arrays of UlmNetworkSimplex (scalar and vectorized
+//    kernels, with stored and implicit costs), and
+//  - fused records {source, target, cost, state} in one array.
+
+#include <ulmon/test/instance.h>
+#include <ulmon/ulm_grid_graph.h>
+#include <ulmon/ulm_grid_solver.h>
+#include <ulmon/utils/pricing.h>
+
+#include <vector>
+
+using namespace lemon;
+using namespace lemon::test;
+
+using Graph = UlmGridGraph<Value, Cost>;
+using Arrays = utils::PricingArrays<Cost>;
+
+TEMPLATE_BPDIGRAPH_TYPEDEFS(Graph);
+
+// Fused arc record, 16 bytes with padding
+struct ArcRecord {
+  int source;
+  int target;
+  Cost cost;
+  signed char state;
+};
+
+void minReducedCostFused(const ArcRecord* arcs, const Cost* pi, int begin,
+                         const int end, Cost& min, int& arg) {
+  for (; begin != end; ++begin) {
+    const ArcRecord& a = arcs[begin];
+    const Cost c = a.state * (a.cost + pi[a.source] - pi[a.target]);
+    if (c < min) {
+      min = c;
+      arg = begin;
+    }
+  }
+}
+
+// Average time of a sweep in ms, the sink keeps the sweeps alive
+template <typename F>
+double sweep(F f, const int it, long& sink) {
+  Results<> t;
+  for (int i = 0; i < it; ++i) {
+    Cost min = 0;
+    int arg = -1;
+    f(min, arg);
+    sink += arg;
+  }
+  return t.toc() / it;
+}
+
+void benchmarkLayout(const int d, const int it) {
+  const int n = d * d;
+  const Int2Array dims{d, d};
+  ValueVector supply = getRandomSupply(n, n, 1.);
+  Graph graph(dims, dims, supply);
+  UlmGridSolver<Graph> solver(graph);
+  solver.run();
+
+  // Internal arrays as in UlmNetworkSimplex with identity ids, the tree arcs
+  // carry flow and are not priced
+  const int m = countArcs(graph);
+  std::vector<signed char> state(m);
+  std::vector<int> source(m), target(m);
+  CostVector cost(m), pi(countNodes(graph));
+  std::vector<ArcRecord> records(m);
+  typename Graph::CostArcMap costMap(graph);
+  for (ArcIt a(graph); a != INVALID; ++a) {
+    const int e = graph.id(a);
+    state[e] = solver.flow(a) ? 0 : 1;
+    source[e] = Graph::id(Node(graph.source(a)));
+    target[e] = Graph::id(Node(graph.target(a)));
+    cost[e] = costMap[a];
+    records[e] = {source[e], target[e], cost[e], state[e]};
+  }
+  for (NodeIt u(graph); u != INVALID; ++u)
+    pi[Graph::id(u)] = solver.potential(u);
+
+  // Implicit costs, the keys are indexed like the nodes
+  graph.implicitCosts(true);
+
+  const Arrays arrays{state.data(), source.data(), target.data(),
+                      cost.data(), pi.data()};
+  Arrays implicit = arrays;
+  implicit.key = graph.costKeys().data();
+  implicit.table = graph.costTable().data();
+  implicit.implicit_begin = 0;
+
+  long sink = 0;
+  const double soa = sweep(
+      [&](Cost& min, int& arg) {
+        utils::minReducedCostScalar(arrays, 0, m, min, arg);
+      },
+      it, sink);
+  const double simd = sweep(
+      [&](Cost& min, int& arg) {
+        utils::minReducedCost(arrays, 0, m, min, arg);
+      },
+      it, sink);
+  const double simd_implicit = sweep(
+      [&](Cost& min, int& arg) {
+        utils::minReducedCost(implicit, 0, m, min, arg);
+      },
+      it, sink);
+  const double fused = sweep(
+      [&](Cost& min, int& arg) {
+        minReducedCostFused(records.data(), pi.data(), 0, m, min, arg);
+      },
+      it, sink);
+
+  fmt::printf("%4dx%-4d%11d%9.2f%9.2f%9.2f%9.2f%6d\n", d, d, m, soa, simd,
+              simd_implicit, fused, sink % 2);
+}
+
+int main(int argc, char** argv) {
+  const int it = argc >= 2 ? std::atoi(argv[1]) : 20;
+  fmt::printf("Time per pricing sweep in ms, record of %d bytes\n",
+              int(sizeof(ArcRecord)));
+  fmt::printf("%9s%11s%9s%9s%9s%9s\n", "dims", "arcs", "scalar", "simd",
+              "implicit", "fused");
+  for (const int d : {64, 128, 256}) benchmarkLayout(d, it);
+  return 0;
+}
@@ -4,8 +4,10 @@
 
 // Main function to run the benchmark
 int main(int argc, char** argv) {
-  int runs = 5;        // runs per pair
-  int resolution = 0;  // 0: run all resolutions
+  int runs = 5;         // runs per pair
+  int resolution = 0;   // 0: run all resolutions
+  int threads = 1;      // threads solving pairs in parallel
+  bool matrix = false;  // distance matrices instead of the comparison
 
   const char* data_directory;
   int data_arg = 0;
@@ -23,10 +25,26 @@ int main(int argc, char** argv) {
 
   if (argc >= 2 + data_arg) runs = std::atoi(argv[1 + data_arg]);
   if (argc >= 3 + data_arg) resolution = std::atoi(argv[2 + data_arg]);
+  if (argc >= 4 + data_arg) threads = std::atoi(argv[3 + data_arg]);
+  if (argc >= 5 + data_arg) matrix = std::atoi(argv[4 + data_arg]);
+  if (threads < 1) {
+    std::cerr << "The number of threads must be positive, got \""
+              << argv[3 + data_arg] << "\"\n";
+    return 1;
+  }
 
   benchmark::DOTmark benchmark(data_directory, runs, resolution);
   benchmark.loadData();
-  benchmark.runBenchmark();
+  if (matrix)
+    benchmark.runDistanceMatrix(threads);
+  else
+    benchmark.runBenchmark(threads);
+
+#ifdef ULMON_TRACE
+  lemon::utils::Tracer::instance().write(
+      (fs::path(data_directory).parent_path() / "Results" / "trace.json")
+          .string());
+#endif
 
   return 0;
 }
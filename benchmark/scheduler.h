@@ -0,0 +1,85 @@
+#ifndef BENCHMARK_SCHEDULER_H
+#define BENCHMARK_SCHEDULER_H
+
+#include <ulmon/utils/statistics.h>
+
+#include <cassert>
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace benchmark {
+
+using lemon::utils::threadCpuMs;
+
+// Work done by one thread of runWorkStealing()
+struct ThreadTimes {
+  int tasks{0};
+  double cpu_ms{0};
+  double wall_ms{0};  // Until the thread found no more work
+};
+
+// Calls task(thread, k) for all k in order on num_threads >= 1 threads,
+// including the calling thread, and returns the times of each thread.
+//
+// The tasks are dealt round-robin to one deque per thread. Each thread takes
+// the tasks of its deque from the front, i.e. in the given order, and when it
+// runs dry it steals from the back of the other deques. The tasks are long
+// running solves, so a mutex per deque is cheap enough.
+template <typename F>
+std::vector<ThreadTimes> runWorkStealing(const std::vector<int>& order,
+                                         const int num_threads, F&& task) {
+  assert(num_threads >= 1);
+  struct Queue {
+    std::mutex mutex;
+    std::deque<int> tasks;
+  };
+  std::vector<Queue> queues(num_threads);
+  for (std::size_t k = 0; k < order.size(); ++k)
+    queues[k % num_threads].tasks.push_back(order[k]);
+
+  // Next task of thread t, its own or a stolen one, or -1 if none is left
+  auto next = [&](const int t) {
+    for (int i = 0; i < num_threads; ++i) {
+      Queue& q = queues[(t + i) % num_threads];
+      std::lock_guard<std::mutex> lock(q.mutex);
+      if (q.tasks.empty()) continue;
+      int k;
+      if (i == 0) {
+        k = q.tasks.front();
+        q.tasks.pop_front();
+      } else {
+        k = q.tasks.back();
+        q.tasks.pop_back();
+      }
+      return k;
+    }
+    return -1;
+  };
+
+  std::vector<ThreadTimes> times(num_threads);
+  const auto start = std::chrono::steady_clock::now();
+  auto work = [&](const int t) {
+    const double cpu0 = threadCpuMs();
+    for (int k; (k = next(t)) != -1;) {
+      task(t, k);
+      ++times[t].tasks;
+    }
+    times[t].cpu_ms = threadCpuMs() - cpu0;
+    times[t].wall_ms = std::chrono::duration<double, std::milli>(
+                           std::chrono::steady_clock::now() - start)
+                           .count();
+  };
+
+  std::vector<std::thread> threads;
+  for (int t = 1; t < num_threads; ++t) threads.emplace_back(work, t);
+  work(0);
+  for (std::thread& thread : threads) thread.join();
+  return times;
+}
+
+};  // namespace benchmark
+
+#endif
@@ -4,7 +4,9 @@
 #include <Common.h>
 #include <LP_Lemon.h>
 #include <ShortCutSolver.h>
+#include <benchmark/scheduler.h>
 #include <ulmon/test/instance.h>
+#include <ulmon/ulm_distance_matrix.h>
 #include <ulmon/ulm_grid_graph.h>
 #include <ulmon/ulm_grid_solver.h>
 
@@ -18,32 +20,51 @@ using ValueVector = std::vector<Value>;
 using Results = lemon::test::Results<TotalCost>;
 
 using Graph = UlmGridGraph<Value, Cost>;
-using GridSolver = UlmGridSolver<Graph>;
-
-// apply GridSolver
-auto gridSolver(Graph& graph) {
-  GridSolver solver(graph);
+using ValueView = Graph::ValueView;
+using Statistics = lemon::utils::SolverStatistics;
+using GridSolver = UlmGridSolver<Graph, Statistics>;
+using DistanceMatrix = UlmDistanceMatrix<Graph, TotalCost>;
+
+// Graph and GridSolver of one resolution, reused for all of its pairs
+struct GridContext {
+  const int resolution;
+  Graph graph;
+  GridSolver solver;
+
+  explicit GridContext(const int resolution)
+      : resolution(resolution),
+        graph({resolution, resolution}, {resolution, resolution},
+              ValueVector(2 * resolution * resolution, 0)),
+        solver(graph) {}
+};
+
+// apply GridSolver, which views the marginals without copying them, the
+// time is the cpu time of the calling thread
+auto gridSolver(GridContext& context, const ValueView supply,
+                const ValueView demand) {
   Results res;
-  res.tic();
-  res.return_value = solver.run();
-  res.toc();
-  res.objective_value = solver.totalCost<TotalCost>();
-  std::vector<std::vector<double>> densities = solver._densities;
-  return std::make_pair(res, densities);
+  const double t0 = threadCpuMs();
+  res.return_value = context.solver.solve(supply, demand);
+  res.t_ms = threadCpuMs() - t0;
+  res.objective_value = context.solver.totalCost<TotalCost>();
+  return std::make_pair(res, context.solver.statistics());
 }
 
 // Adapted from Schmitzer's MultiScaleOT/src/Examples/ShortCut.cpp
-Results schmitzerMultiScale(int* dim, ValueVector& supply, int depth) {
+// The marginals are normalized into one array of doubles, which is the only
+// copy of them
+Results schmitzerMultiScale(int* dim, const ValueView supply,
+                            const ValueView demand, int depth) {
   int msg;
   const int n = dim[0] * dim[1];
 
-  std::vector<double> supplyNormalized(supply.size());
+  std::vector<double> supplyNormalized(2 * n);
   Value totalSupply = 0;
   for (int i = 0; i < n; ++i) totalSupply += supply[i];
   for (int i = 0; i < n; ++i)
     supplyNormalized[i] = static_cast<double>(supply[i]) / totalSupply;
-  for (int i = n; i < 2 * n; ++i)
-    supplyNormalized[i] = -static_cast<double>(supply[i]) / totalSupply;
+  for (int i = 0; i < n; ++i)
+    supplyNormalized[n + i] = static_cast<double>(demand[i]) / totalSupply;
   double* muXdat = &supplyNormalized[0];
   double* muYdat = &supplyNormalized[n];
 
@@ -133,8 +154,9 @@ Results schmitzerMultiScale(int* dim, ValueVector& supply, int depth) {
   MultiScaleSolver.autoDeletePointers = false;
 
   Results results;
+  const double t0 = threadCpuMs();
   msg = MultiScaleSolver.solve();
-  results.toc();
+  results.t_ms = threadCpuMs() - t0;
   results.objective_value = MultiScaleSolver.objective * totalSupply;
   results.return_value = msg == 0;
   assert(msg == 0);
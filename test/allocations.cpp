@@ -0,0 +1,48 @@
+#include <ulmon/test/allocations.h>
+#include <ulmon/test/instance.h>
+#include <ulmon/ulm_grid_graph.h>
+#include <ulmon/ulm_grid_solver.h>
+
+#include <cassert>
+
+using namespace lemon;
+using namespace lemon::test;
+
+using Graph = UlmGridGraph<Value, Cost>;
+using Solver = UlmGridSolver<Graph>;
+
+/// \brief A repeated run of the solver reuses the storage of all levels and
+/// does not allocate, also with a thread pool
+void testRepeatedRun(const int d, const bool implicit,
+                     const int num_threads = 1) {
+  fmt::printf("testRepeatedRun %d %d %d:\t", d, implicit, num_threads);
+  const Int2Array dims{d, d};
+  ValueVector supply = getRandomSupply(d * d, d * d, 1.);
+  Graph graph(dims, dims, supply);
+  if (implicit) graph.implicitCosts(true);
+  Solver solver(graph);
+  solver.threads(num_threads);
+
+  [[maybe_unused]] auto type = solver.run();
+  assert(type == Solver::NetSimplex::OPTIMAL);
+  [[maybe_unused]] const Cost cost = solver.totalCost();
+
+  const long before = allocations;
+  type = solver.run();
+  [[maybe_unused]] const long num = allocations - before;
+  assert(type == Solver::NetSimplex::OPTIMAL);
+  assert(solver.totalCost() == cost);
+  assert(num == 0);
+
+  fmt::printf("OK\n");
+}
+
+int main() {
+  testRepeatedRun(16, false);
+  testRepeatedRun(32, false);
+  testRepeatedRun(32, true);
+  testRepeatedRun(48, true);
+  testRepeatedRun(32, false, 3);
+  testRepeatedRun(48, true, 3);
+  return 0;
+}
@@ -0,0 +1,161 @@
+#include <ulmon/test/instance.h>
+#include <ulmon/utils/pricing.h>
+
+#include <cassert>
+#include <random>
+#include <vector>
+
+#ifndef ULMON_CONST_ARCS
+#define ULMON_CONST_ARCS 1000000
+#endif
+
+#ifndef ULMON_CONST_NODES
+#define ULMON_CONST_NODES 10000
+#endif
+
+#ifndef ULMON_CONST_IT
+#define ULMON_CONST_IT 1000
+#endif
+
+using namespace lemon;
+using namespace lemon::test;
+
+using Arrays = utils::PricingArrays<Cost>;
+
+struct Instance {
+  std::vector<signed char> state;
+  std::vector<int> source, target;
+  CostVector cost, pi;
+
+  // Implicit costs of the arcs from implicit_begin on
+  std::vector<int> key;
+  CostVector table;
+  int implicit_begin;
+
+  Arrays arrays(const bool implicit = false) const {
+    Arrays a{state.data(), source.data(), target.data(), cost.data(),
+             pi.data()};
+    if (implicit) {
+      a.key = key.data();
+      a.table = table.data() + key.size() - 1;
+      a.implicit_begin = implicit_begin;
+    }
+    return a;
+  }
+};
+
+/// \brief Random arcs whose reduced costs are mostly nonnegative, as near the
+/// end of a network simplex run
+Instance randomInstance(const int m, const int n) {
+  Instance inst;
+  std::uniform_int_distribution<int> node(0, n - 1);
+  std::uniform_int_distribution<int> state(-1, 1);
+  std::uniform_int_distribution<Cost> cost(0, 1000000);
+  std::uniform_int_distribution<Cost> pot(-1000, 1000);
+  for (int e = 0; e < m; ++e) {
+    inst.state.push_back(state(mt));
+    inst.source.push_back(node(mt));
+    inst.target.push_back(node(mt));
+    inst.cost.push_back(cost(mt));
+  }
+  for (int u = 0; u < n; ++u) inst.pi.push_back(pot(mt));
+  // Plant big potentials as with artificial arcs
+  inst.pi[0] = inst.pi[1] = std::numeric_limits<Cost>::max() / 2 + 1;
+
+  // Key differences lie in (-n, n), hence the table is shifted by n - 1
+  for (int u = 0; u < n; ++u) inst.key.push_back(node(mt));
+  for (int d = 0; d < 2 * n - 1; ++d) inst.table.push_back(cost(mt));
+  inst.implicit_begin = m / 3;
+  return inst;
+}
+
+using FirstNegative = int (*)(const Arrays&, int, int);
+using MinReducedCost = void (*)(const Arrays&, int, int, Cost&, int&);
+
+/// \brief Compares a kernel against the scalar kernel on random ranges
+void testKernel(const char* name, FirstNegative first, MinReducedCost min,
+                const bool implicit = false) {
+  fmt::printf("testKernel(%s%s):\t", name, implicit ? ", implicit" : "");
+  Instance inst = randomInstance(ULMON_CONST_ARCS, ULMON_CONST_NODES);
+  const Arrays a = inst.arrays(implicit);
+  std::uniform_int_distribution<int> arc(0, ULMON_CONST_ARCS);
+
+  for (int it = 0; it < ULMON_CONST_IT; ++it) {
+    int begin = arc(mt), end = arc(mt);
+    if (begin > end) std::swap(begin, end);
+    if (it % 2) end = std::min(begin + it % 41, end);  // Short ranges
+
+    int ref_first = begin;
+    while (ref_first != end && a.reducedCost(ref_first) >= 0) ++ref_first;
+    assert(ref_first == utils::firstNegativeScalar(a, begin, end));
+    assert(first(a, begin, end) == ref_first);
+
+    Cost ref_min = it % 3 ? 0 : -it, test_min = ref_min;
+    int ref_arg = -1, test_arg = -1;
+    utils::minReducedCostScalar(a, begin, end, ref_min, ref_arg);
+    min(a, begin, end, test_min, test_arg);
+    assert(ref_min == test_min);
+    assert(ref_arg == test_arg);
+  }
+
+  // Throughput on the whole range
+  Results<> t;
+  Cost m = 0;
+  int arg = -1;
+  for (int it = 0; it < 10; ++it) min(a, 0, ULMON_CONST_ARCS, m, arg);
+  t.toc();
+  fmt::printf("OK (%.2f ms per sweep)\n", t.t_ms / 10);
+}
+
+/// \brief Compares the parallel block search against the sequential one
+void testBlockSearch(const int num_threads, const int min_parallel_arcs) {
+  fmt::printf("testBlockSearch(%d, %d):\t", num_threads, min_parallel_arcs);
+  Instance inst = randomInstance(ULMON_CONST_ARCS, ULMON_CONST_NODES);
+  // Few eligible arcs, so that searches span several rounds and wrap around
+  std::uniform_int_distribution<int> eligible(0, 99999);
+  for (signed char &s : inst.state)
+    if (eligible(mt)) s = 0;
+  const Arrays a = inst.arrays();
+  utils::ThreadPool pool(num_threads);
+  std::uniform_int_distribution<int> arc(0, ULMON_CONST_ARCS);
+  std::uniform_int_distribution<int> block(1, 5000);
+
+  for (int it = 0; it < ULMON_CONST_IT; ++it) {
+    int begin = arc(mt), end = arc(mt);
+    if (begin > end) std::swap(begin, end);
+    const int block_size = block(mt);
+    const int next = begin + (end - begin) / (1 + it % 7);
+
+    int ref_next = next, test_next = next;
+    int ref_arg = -1, test_arg = -1;
+    const bool ref = utils::blockSearch(a, begin, ref_next, end, block_size,
+                                        ref_arg);
+    const bool test = utils::blockSearch(a, begin, test_next, end,
+                                         block_size, test_arg, pool,
+                                         min_parallel_arcs);
+    assert(ref == test);
+    assert(ref_next == test_next);
+    assert(ref_arg == test_arg);
+  }
+
+  fmt::printf("OK\n");
+}
+
+int main() {
+  for (const bool implicit : {false, true}) {
+    testKernel("scalar", utils::firstNegativeScalar<Cost>,
+               utils::minReducedCostScalar<Cost>, implicit);
+#ifdef ULMON_SIMD_X86
+    if (utils::simdLevel() >= utils::SimdLevel::AVX2)
+      testKernel("avx2", utils::firstNegativeAvx2, utils::minReducedCostAvx2,
+                 implicit);
+    if (utils::simdLevel() >= utils::SimdLevel::AVX512)
+      testKernel("avx512", utils::firstNegativeAvx512,
+                 utils::minReducedCostAvx512, implicit);
+#endif
+  }
+  testBlockSearch(1, 0);
+  testBlockSearch(4, 0);
+  testBlockSearch(4, 4096);
+  return 0;
+}
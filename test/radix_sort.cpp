@@ -0,0 +1,45 @@
+#include <ulmon/test/instance.h>
+#include <ulmon/utils/radix_sort.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <random>
+
+using namespace lemon;
+
+/// \brief Radix sort agrees with std::stable_sort
+void testRadixSort(const std::uint64_t max_key, const int n) {
+  fmt::printf("testRadixSort %d:\t", max_key);
+  std::mt19937_64 gen(n);
+  std::uniform_int_distribution<std::uint64_t> dist(0, max_key);
+
+  utils::KeyedVector<int> items, scratch;
+  for (int i = 0; i < n; ++i) items.emplace_back(dist(gen), i);
+  utils::KeyedVector<int> ref = items;
+  std::stable_sort(ref.begin(), ref.end(), [](const auto& a, const auto& b) {
+    return a.first < b.first;
+  });
+
+  utils::radixSort(items, scratch, max_key);
+  assert(items == ref);
+
+  // Reverse the keys and reuse the scratch vector
+  for (auto& item : items) item.first = max_key - item.first;
+  for (auto& item : ref) item.first = max_key - item.first;
+  std::stable_sort(ref.begin(), ref.end(), [](const auto& a, const auto& b) {
+    return a.first < b.first;
+  });
+  utils::radixSort(items, scratch, max_key);
+  assert(items == ref);
+
+  fmt::printf("OK\n");
+}
+
+int main() {
+  testRadixSort(0, 10);
+  testRadixSort(200, 1000);
+  testRadixSort(std::uint64_t(1) << 40, 10000);
+  testRadixSort(~std::uint64_t(0), 1000);
+  return 0;
+}
@@ -126,6 +126,61 @@ void testShielded2(const int n) {
   fmt::printf("OK\n", n);
 }
 
+/// \brief Test shielded pivot rule on instances whose support is not
+/// monotone along the grid axes
+///
+/// The neighbors of a red node shrink its shield past its own support on these
+/// instances. Without extending the shield to the support, the shielded pivot
+/// rule stopped at a suboptimal flow.
+void testShieldedSupport() {
+  fmt::printf("testShieldedSupport():\t");
+  using Ref = NetworkSimplex<Graph>;
+
+  // Dimensions of grid
+  const int n = 10;
+  Int2Array muXdim = {n, n};
+  Int2Array muYdim = {n, n};
+  int nx = muXdim[0] * muXdim[1];
+  int ny = muYdim[0] * muYdim[1];
+
+  Int2Array pos{};
+  PosVector yMin, yMax;
+  for (int i = 0; i < nx; ++i) {
+    yMin.push_back(pos);
+    yMax.push_back({pos[0] + 1, pos[1] + 1});
+    utils::advancePos(muYdim, pos);
+  }
+
+  for (const unsigned seed : {6, 12}) {
+    fmt::printf(".");
+
+    // Marginals
+    mt.seed(seed);
+    ValueVector supply;
+    setupSupply(nx, ny, supply, .4);
+
+    Graph refG(muXdim, muYdim, supply, true);
+    SupplyNodeMap refSupply(refG);
+    CostArcMap refCost(refG);
+    Ref ref(refG);
+    ref.supplyMap(refSupply).costMap(refCost);
+    typename Ref::ProblemType r = ref.run();
+    assert(r == Ref::OPTIMAL);
+
+    Graph testG(muXdim, muYdim, supply, yMin, yMax);
+    Test test(testG);
+    SupplyNodeMap testSupply(testG);
+    CostArcMap testCost(testG);
+    test.supplyMap(testSupply).costMap(testCost);
+    typename Test::ProblemType t = test.runShielded();
+    assert(t == Test::OPTIMAL);
+
+    assert(ref.totalCost() == test.totalCost());
+  }
+
+  fmt::printf("OK\n");
+}
+
 int main() {
   for (int d = ULMON_CONST_D / 4; d <= ULMON_CONST_D; d += ULMON_CONST_DELTA) {
     testShielded1(d);
@@ -133,5 +188,6 @@ int main() {
   for (int d = ULMON_CONST_D / 4; d <= ULMON_CONST_D; d += ULMON_CONST_DELTA) {
     testShielded2(d);
   }
+  testShieldedSupport();
   return 0;
 }
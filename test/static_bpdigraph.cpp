@@ -0,0 +1,95 @@
+#include <ulmon/concepts/bpdigraph.h>
+#include <ulmon/smart_bpdigraph.h>
+#include <ulmon/static_bpdigraph.h>
+
+#include <algorithm>
+#include <cassert>
+#include <random>
+#include <vector>
+
+using namespace lemon;
+
+/// \brief Checks that both graphs traverse the same arcs in the same order
+void checkEqual(const SmartBpDigraph& smart, const StaticBpDigraph& graph) {
+  assert(smart.arcNum() == graph.arcNum());
+  std::vector<int> a, b;
+  for (SmartBpDigraph::ArcIt e(smart); e != INVALID; ++e)
+    a.push_back(smart.id(e));
+  for (StaticBpDigraph::ArcIt e(graph); e != INVALID; ++e)
+    b.push_back(graph.id(e));
+  assert(a == b);
+
+  for (int x = 0; x < graph.redNum(); ++x) {
+    a.clear(), b.clear();
+    for (SmartBpDigraph::OutArcIt e(smart, smart.redNode(x)); e != INVALID;
+         ++e)
+      a.push_back(smart.id(e));
+    for (StaticBpDigraph::OutArcIt e(graph, graph.redNode(x)); e != INVALID;
+         ++e) {
+      assert(graph.id(graph.source(e, StaticBpDigraph::RedNode{})) == x);
+      b.push_back(graph.id(e));
+    }
+    assert(a == b);
+  }
+
+  for (int y = 0; y < graph.blueNum(); ++y) {
+    a.clear(), b.clear();
+    for (SmartBpDigraph::InArcIt e(smart, smart.blueNode(y)); e != INVALID;
+         ++e)
+      a.push_back(smart.id(e));
+    for (StaticBpDigraph::InArcIt e(graph, graph.blueNode(y)); e != INVALID;
+         ++e) {
+      assert(graph.id(graph.target(e, StaticBpDigraph::BlueNode{})) == y);
+      b.push_back(graph.id(e));
+    }
+    assert(a == b);
+  }
+}
+
+int main() {
+  // If this compiles, then StaticBpDigraph fulfills the BpDigraph concept
+  lemon::concepts::BpDigraph::Constraints<StaticBpDigraph> constraints;
+  constraints.constraints();
+
+  const int red_num = 7, blue_num = 5;
+  SmartBpDigraph smart(red_num, blue_num);
+  StaticBpDigraph graph(red_num, blue_num);
+  assert(graph.redNum() == red_num);
+  assert(graph.blueNum() == blue_num);
+  assert(graph.nodeNum() == red_num + blue_num);
+
+  // Arcs grouped by red node, some red nodes without arcs
+  auto add = [&](const int x, const int y) {
+    smart.addArc(smart.redNode(x), smart.blueNode(y));
+    graph.addArc(graph.redNode(x), graph.blueNode(y));
+  };
+  for (int x : {1, 2, 2, 4}) {
+    for (int y = 0; y < blue_num; y += x) add(x, y);
+  }
+  add(red_num - 1, 0);
+  assert(graph.grouped());
+  checkEqual(smart, graph);
+
+  // Appending to the last red node keeps the grouping, in arcs are linked
+  // again on demand
+  add(red_num - 1, blue_num - 1);
+  assert(graph.grouped());
+  checkEqual(smart, graph);
+
+  // Arcs out of order switch to linked out arcs
+  std::mt19937 mt(0);
+  std::uniform_int_distribution<int> red(0, red_num - 1), blue(0, blue_num - 1);
+  for (int i = 0; i < 20; ++i) add(red(mt), blue(mt));
+  assert(!graph.grouped());
+  checkEqual(smart, graph);
+
+  // Clearing restores the grouping
+  smart.clearArcs();
+  graph.clearArcs();
+  assert(graph.grouped());
+  assert(graph.arcNum() == 0);
+  checkEqual(smart, graph);
+  for (int x = 0; x < red_num; ++x) add(x, x % blue_num);
+  assert(graph.grouped());
+  checkEqual(smart, graph);
+}
@@ -0,0 +1,81 @@
+#ifndef ULMON_TRACE
+#define ULMON_TRACE
+#endif
+
+#include <ulmon/test/instance.h>
+#include <ulmon/ulm_grid_graph.h>
+#include <ulmon/ulm_grid_solver.h>
+#include <ulmon/utils/trace.h>
+
+#include <cassert>
+#include <sstream>
+#include <string>
+
+using namespace lemon;
+using namespace lemon::test;
+
+using Graph = UlmGridGraph<Value, Cost>;
+
+// Number of non-overlapping occurrences of pattern in text
+int count(const std::string& text, const std::string& pattern) {
+  int n = 0;
+  for (std::size_t i = text.find(pattern); i != std::string::npos;
+       i = text.find(pattern, i + pattern.size()))
+    ++n;
+  return n;
+}
+
+/// \brief Checks nesting and output of scopes
+void testScopes() {
+  fmt::printf("testScopes:\t\t");
+  utils::Tracer& tracer = utils::Tracer::instance();
+  tracer.clear();
+  {
+    ULMON_TRACE_SCOPE("outer", "level", 7);
+    ULMON_TRACE_SCOPE("inner");
+  }
+  assert(tracer.size() == 2);
+
+  std::ostringstream os;
+  tracer.write(os);
+  const std::string json = os.str();
+  assert(json.rfind("{\"traceEvents\":[", 0) == 0);
+  assert(count(json, "\"ph\":\"X\"") == 2);
+  assert(count(json, "\"name\":\"outer\"") == 1);
+  assert(count(json, "\"args\":{\"level\":7}") == 1);
+
+  // Inner scopes end first
+  assert(json.find("\"inner\"") < json.find("\"outer\""));
+  fmt::printf("OK\n");
+}
+
+/// \brief Checks that a solve records one subsolve per level
+void testSolver() {
+  fmt::printf("testSolver:\t\t");
+  utils::Tracer& tracer = utils::Tracer::instance();
+  tracer.clear();
+
+  Int2Array dims{16, 16};
+  const int n = dims[0] * dims[1];
+  ValueVector supply = getRandomSupply(n, n, 1.);
+  Graph graph(dims, dims, supply);
+  UlmGridSolver<Graph> solver(graph);
+  solver.run();
+
+  std::ostringstream os;
+  tracer.write(os);
+  const std::string json = os.str();
+  const int levels = utils::hierarchicalDepth(dims, dims, 2) + 1;
+  assert(count(json, "\"name\":\"subsolve\"") == levels);
+  assert(count(json, "\"name\":\"run\"") == levels);
+  assert(count(json, "\"name\":\"prepare\"") == levels - 1);
+  assert(count(json, "\"name\":\"rebuildShield\"") ==
+         count(json, "\"name\":\"rebuildInternals\""));
+  fmt::printf("OK\n");
+}
+
+int main() {
+  testScopes();
+  testSolver();
+  return 0;
+}
@@ -0,0 +1,71 @@
+#include <ulmon/test/instance.h>
+#include <ulmon/ulm_distance_matrix.h>
+#include <ulmon/ulm_grid_graph.h>
+#include <ulmon/ulm_grid_solver.h>
+
+#include <cassert>
+
+using namespace lemon;
+using namespace lemon::test;
+
+using Graph = UlmGridGraph<Value, Cost>;
+using Matrix = UlmDistanceMatrix<Graph>;
+using TestSolver = Matrix::Solver;
+
+/// \brief The matrix agrees with solving both directions of each pair, and
+/// the plans of both directions are transposes with the optimal cost
+void testDistanceMatrix(const int d, const int num, const int num_threads) {
+  fmt::printf("testDistanceMatrix %d %d %d:\t", d, num, num_threads);
+  const Int2Array dims{d, d};
+  const int n = d * d;
+
+  // Marginals with equal sums, see setupSupply()
+  std::vector<ValueVector> marginals(num);
+  for (ValueVector& mu : marginals) {
+    mu = getRandomSupply(n, n, 1.);
+    mu.resize(n);
+  }
+  Matrix matrix(dims, {marginals.begin(), marginals.end()});
+  matrix.threads(num_threads);
+  [[maybe_unused]] auto type = matrix.run();
+  assert(type == TestSolver::NetSimplex::OPTIMAL);
+  assert(matrix.size() == num);
+  assert(int(matrix.matrix().size()) == num * num);
+
+  Graph graph(dims, dims, ValueVector(2 * n, 0));
+  TestSolver solver(graph);
+  for (int i = 0; i < num; ++i) {
+    assert(matrix.distance(i, i) == 0);
+    for (int j = 0; j < num; ++j) {
+      if (i == j) continue;
+      solver.solve(marginals[i], marginals[j]);
+      assert(matrix.distance(i, j) == solver.totalCost<long>());
+      assert(matrix.distance(i, j) == matrix.distance(j, i));
+    }
+  }
+
+  // Plan of the reversed direction
+  SquaredEuclidean<Cost, Dim> metric;
+  Graph::SupplyNodeMap supplyMap(graph);
+  ValueVector out(n, 0), in(n, 0);
+  long cost = 0;
+  type = matrix.plan(1, 0, [&](const int x, const int y, const Value v) {
+    out[x] += v;
+    in[y] += v;
+    cost += long(v) * metric(graph.getPos(graph.redNode(x)),
+                             graph.getPos(graph.blueNode(y)));
+  });
+  assert(type == TestSolver::NetSimplex::OPTIMAL);
+  assert(out == marginals[1]);
+  assert(in == marginals[0]);
+  assert(cost == matrix.distance(1, 0));
+
+  fmt::printf("OK\n");
+}
+
+int main() {
+  testDistanceMatrix(8, 4, 1);
+  testDistanceMatrix(16, 5, 1);
+  testDistanceMatrix(16, 5, 3);
+  return 0;
+}
@@ -2,6 +2,11 @@
 #include <ulmon/test/instance.h>
 #include <ulmon/ulm_grid_graph.h>
 
+#include <algorithm>
+#include <cstdint>
+#include <set>
+#include <type_traits>
+
 #ifndef ULMON_CONST_DENSITY
 #define ULMON_CONST_DENSITY .5
 #endif
@@ -10,6 +15,13 @@ using namespace lemon;
 using namespace lemon::test;
 
 using Graph = UlmGridGraph<Value, Cost>;
+
+// The graph keeps views of the marginals, hence temporaries are rejected
+static_assert(std::is_constructible_v<Graph::ValueView, ValueVector&>);
+static_assert(!std::is_constructible_v<Graph::ValueView, ValueVector&&>);
+static_assert(!std::is_constructible_v<Graph, Int2Array, Int2Array,
+                                       ValueVector&&, ValueVector&&>);
+
 TEMPLATE_BPDIGRAPH_TYPEDEFS(Graph);
 using Ref = NetworkSimplex<Graph, typename Graph::Value, typename Graph::Cost>;
 
@@ -138,6 +150,37 @@ void testCtor3Supply() {
   fmt::printf("OK\n");
 }
 
+void testCtor4Supply() {
+  fmt::printf("testCtor4Supply:\t");
+  // Dimensions of grid
+  Int2Array muXdim = {8, 8};
+  Int2Array muYdim = {4, 4};
+  int nx = muXdim[0] * muXdim[1];
+  int ny = muYdim[0] * muYdim[1];
+
+  // Marginals, the views see changes of the viewed memory
+  ValueVector supply = test::getRandomSupply(nx, ny, ULMON_CONST_DENSITY);
+  ValueVector x_supply(supply.begin(), supply.begin() + nx);
+  ValueVector y_demand(ny);
+  for (int y = 0; y < ny; ++y) y_demand[y] = -supply[nx + y];
+  Graph graph(muXdim, muYdim, supply);
+  Graph view(muXdim, muYdim, x_supply, y_demand);
+  Graph::SupplyNodeMap supplyMap(graph), viewMap(view);
+  for (NodeIt u(graph); u != INVALID; ++u) assert(supplyMap[u] == viewMap[u]);
+
+  std::swap(x_supply[0], x_supply[nx - 1]);
+  assert(viewMap[view.redNode(0)] == supply[nx - 1]);
+
+  // Coarsening copies the marginals
+  Graph coarse(view, 2);
+  Graph::SupplyNodeMap coarseMap(coarse);
+  Value sum = 0;
+  for (RedNodeIt x(coarse); x != INVALID; ++x) sum += coarseMap[x];
+  assert(sum == std::reduce(x_supply.begin(), x_supply.end()));
+
+  fmt::printf("OK\n");
+}
+
 void testRebuildShield1() {
   fmt::printf("testRebuildShield1:\t");
   constexpr int n = 7;
@@ -257,6 +300,189 @@ void testRebuildShield3() {
     assert(support[i].second == graph.target(support_arcs[i], BlueNode{}));
   }
 
+  // All arcs are in the shield
+  for (ArcIt a(graph); a != INVALID; ++a) {
+    assert(graph.shieldArc(graph.source(a, RedNode{}),
+                           graph.target(a, BlueNode{})) == a);
+  }
+  assert(graph.shieldArc(graph.redNode(0), graph.blueNode(n * n - 1)) ==
+         INVALID);
+
+  // The support does not need to be sorted
+  std::reverse(support.begin(), support.end());
+  graph.rebuildShield(support, support_flow, support_arcs);
+  for (std::size_t i = 0; i < support.size(); ++i) {
+    assert(support[i].first == graph.source(support_arcs[i], RedNode{}));
+    assert(support[i].second == graph.target(support_arcs[i], BlueNode{}));
+  }
+
+  fmt::printf("OK\n");
+}
+
+/// \brief Shields constructed in parallel equal sequential ones
+void testParallelShield() {
+  fmt::printf("testParallelShield:\t");
+  constexpr int n = 9;
+
+  // Dimensions of grid
+  Int2Array muXdim = {n, n};
+  Int2Array muYdim = {n, n};
+  int nx = muXdim[0] * muXdim[1];
+  int ny = muYdim[0] * muYdim[1];
+
+  // Marginals
+  ValueVector supply = test::getRandomSupply(nx, ny, ULMON_CONST_DENSITY);
+  for (auto& s : supply) ++s;
+  Graph ref(muXdim, muYdim, supply);
+  Graph test(muXdim, muYdim, supply);
+  utils::ThreadPool pool(4);
+
+  auto compare = [&]() {
+    assert(countArcs(test) == countArcs(ref));
+    typename Graph::CostArcMap refCost(ref), testCost(test);
+    for (ArcIt a(ref); a != INVALID; ++a) {
+      assert(test.source(a) == ref.source(a));
+      assert(test.target(a) == ref.target(a));
+      assert(testCost[a] == refCost[a]);
+    }
+    for (RedNodeIt x(ref); x != INVALID; ++x)
+      assert(countOutArcs(test, x) == countOutArcs(ref, x));
+  };
+
+  // Rebuild from a shifted support
+  using SupportVector = typename Graph::SupportVector;
+  SupportVector support;
+  for (int i = 0; i < nx; ++i)
+    support.emplace_back(ref.redNode(i), ref.blueNode((i + 3 * n + 1) % ny));
+  ValueVector support_flow(support.size(), 1);
+  typename Graph::ArcVector ref_arcs, test_arcs;
+  ref.rebuildShield(support, support_flow, ref_arcs);
+  test.rebuildShield(support, support_flow, test_arcs, &pool);
+  compare();
+  assert(ref_arcs == test_arcs);
+
+  // Enlarge it, each arc is added once
+  const int m = countArcs(test);
+  for (auto& [x, y] : support) y = ref.blueNode(ref.id(x));
+  ref.updateShield(support);
+  test.updateShield(support, &pool);
+  compare();
+  assert(countArcs(test) > m);
+  std::set<std::pair<int, int>> arcs;
+  for (ArcIt a(test); a != INVALID; ++a)
+    arcs.emplace(test.id(test.source(a)), test.id(test.target(a)));
+  assert(arcs.size() == std::size_t(countArcs(test)));
+
+  fmt::printf("OK\n");
+}
+
+void testImplicitCosts() {
+  fmt::printf("testImplicitCosts:\t");
+
+  // Dimensions of grid, different for red and blue nodes
+  Int2Array muXdim = {6, 9};
+  Int2Array muYdim = {7, 4};
+  int nx = muXdim[0] * muXdim[1];
+  int ny = muYdim[0] * muYdim[1];
+
+  // Marginals
+  ValueVector supply = test::getRandomSupply(nx, ny, ULMON_CONST_DENSITY);
+  Graph graph(muXdim, muYdim, supply), implicitGraph(muXdim, muYdim, supply);
+  implicitGraph.implicitCosts(true);
+  graph.addAllArcs();
+  implicitGraph.addAllArcs();
+  assert(countArcs(graph) == countArcs(implicitGraph));
+
+  // Test costs
+  Graph::CostArcMap costMap(graph), implicitCostMap(implicitGraph);
+  for (ArcIt a(graph); a != INVALID; ++a) {
+    assert(costMap[a] == implicitCostMap[a]);
+  }
+
+  // Coarse graphs inherit the setting
+  Graph coarseGraph(implicitGraph, 2);
+  assert(coarseGraph.implicitCosts());
+
+  // Switching back restores the stored costs
+  implicitGraph.implicitCosts(false);
+  for (ArcIt a(graph); a != INVALID; ++a) {
+    assert(costMap[a] == implicitCostMap[a]);
+  }
+
+  fmt::printf("OK\n");
+}
+
+/// \brief Adding boxes at once equals adding them one by one
+template <typename G>
+void testAddArcBoxes(utils::ThreadPool* pool) {
+  fmt::printf("testAddArcBoxes(%d):\t", pool ? pool->size() : 0);
+
+  // Dimensions of grid
+  Int2Array muXdim = {6, 6};
+  Int2Array muYdim = {6, 6};
+  int nx = muXdim[0] * muXdim[1];
+  int ny = muYdim[0] * muYdim[1];
+
+  // Marginals
+  ValueVector supply = test::getRandomSupply(nx, ny, ULMON_CONST_DENSITY);
+  G ref(muXdim, muYdim, supply);
+  G test(muXdim, muYdim, supply);
+
+  // Boxes with shared red nodes, the second one goes back in the red nodes
+  using ArcBox = typename G::ArcBox;
+  std::vector<ArcBox> boxes{{{2, 2}, {4, 4}, {0, 0}, {2, 3}, 0},
+                            {{0, 0}, {3, 3}, {4, 4}, {6, 6}, 0},
+                            {{2, 2}, {4, 4}, {3, 3}, {4, 6}, 0}};
+  for (const ArcBox& b : boxes) ref.addArcs(b.x_min, b.x_max, b.y_min, b.y_max);
+  test.addArcBoxes(boxes, pool);
+
+  assert(boxes[0].first_arc == 0);
+  assert(boxes[1].first_arc == 4 * 6);
+  assert(boxes[2].first_arc == 4 * 6 + 9 * 4);
+  assert(countArcs(test) == countArcs(ref));
+  typename G::CostArcMap refCost(ref), testCost(test);
+  for (int i = 0; i < countArcs(ref); ++i) {
+    const typename G::Arc a = ref.arcFromId(i);
+    assert(test.source(a) == ref.source(a));
+    assert(test.target(a) == ref.target(a));
+    assert(testCost[a] == refCost[a]);
+  }
+  for (typename G::RedNodeIt x(ref); x != INVALID; ++x) {
+    typename G::OutArcIt a(ref, x), b(test, x);
+    for (; a != INVALID; ++a, ++b) assert(a == b);
+    assert(b == INVALID);
+  }
+  for (typename G::BlueNodeIt y(ref); y != INVALID; ++y)
+    assert(countInArcs(test, y) == countInArcs(ref, y));
+
+  fmt::printf("OK\n");
+}
+
+void testLargeGrid() {
+  fmt::printf("testLargeGrid:\t\t");
+
+  // Dimensions of grid, 2^36 potential arcs
+  Int2Array muXdim = {512, 512};
+  Int2Array muYdim = {512, 512};
+  int nx = muXdim[0] * muXdim[1];
+  int ny = muYdim[0] * muYdim[1];
+  assert(utils::numNodes(muXdim) == nx);
+  assert(utils::numArcs<std::int64_t>(PosVector(nx), PosVector(nx, muYdim)) ==
+         std::int64_t(1) << 36);
+
+  // All arcs do not fit into the arc ids. They would not fit into memory
+  // either, the grid solver only materializes the shields.
+  ValueVector supply = test::getRandomSupply(nx, ny, ULMON_CONST_DENSITY);
+  Graph graph(muXdim, muYdim, supply);
+  bool thrown = false;
+  try {
+    graph.addAllArcs();
+  } catch (const utils::ArcOverflowError&) {
+    thrown = true;
+  }
+  assert(thrown);
+  assert(countArcs(graph) == 0);
+
   fmt::printf("OK\n");
 }
 
@@ -265,8 +491,17 @@ int main() {
   testCtor2();
   testCtor3AddArcs();
   testCtor3Supply();
+  testCtor4Supply();
   testRebuildShield1();
   testRebuildShield2();
   testRebuildShield3();
+  testParallelShield();
+  testImplicitCosts();
+  utils::ThreadPool pool(4);
+  testAddArcBoxes<Graph>(nullptr);
+  testAddArcBoxes<Graph>(&pool);
+  testAddArcBoxes<UlmGridGraph<Value, Cost, 2, SquaredEuclidean<Cost, 2>,
+                               StaticBpDigraph>>(&pool);
+  testLargeGrid();
   return 0;
 }
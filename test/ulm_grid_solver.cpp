@@ -30,8 +30,11 @@ using namespace lemon;
 using namespace lemon::test;
 
 using Graph = UlmGridGraph<Value, Cost>;
+using StaticGraph = UlmGridGraph<Value, Cost, Dim, SquaredEuclidean<Cost, Dim>,
+                                 StaticBpDigraph>;
 using TestSolver = UlmGridSolver<Graph>;
-using TestSubsolver = UlmNetworkSimplex<Graph, Value>;
+using StatsSolver = UlmGridSolver<Graph, utils::SolverStatistics>;
+using TestSubsolver = TestSolver::NetSimplex;
 
 /// \brief Test subsolve method
 void testSubsolve(const Int2Array dims) {
@@ -84,6 +87,10 @@ void testRun(const Int2Array dims) {
   // Grid dimensions
   const int n = dims[0] * dims[1];
 
+  // Solver reused for the supplies of all iterations
+  Graph reusedGraph(dims, dims, ValueVector(2 * n, 0));
+  TestSolver reusedS(reusedGraph);
+
   long double t_ref = 0, t_test = 0;
   bool ok = true;
   for (int it = 0; it < ULMON_CONST_IT; ++it) {
@@ -109,8 +116,62 @@ void testRun(const Int2Array dims) {
     t.toc();
     t.objective_value = testS.totalCost();
 
+    // Test with implicit costs
+    Graph implicitGraph(dims, dims, supply);
+    implicitGraph.implicitCosts(true);
+    TestSolver implicitS(implicitGraph);
+    implicitS.run();
+
+    // Test with incrementally updated shields
+    Graph incrementalGraph(dims, dims, supply);
+    TestSolver incrementalS(incrementalGraph);
+    incrementalS.incrementalShield();
+    incrementalS.run();
+
+    // Test with the reused solver, alternately on a copy and on views of
+    // the marginals
+    ValueVector demand(n);
+    for (int i = 0; i < n; ++i) demand[i] = -supply[n + i];
+    if (it % 2 == 0)
+      reusedS.solve(supply);
+    else
+      reusedS.solve({supply.data(), std::size_t(n)}, demand);
+
+    // Test with parallel pricing and shield construction
+    Graph threadedGraph(dims, dims, supply);
+    TestSolver threadedS(threadedGraph);
+    threadedS.threads(3);
+    threadedS.run();
+
+    // Test with compact arc storage
+    StaticGraph staticGraph(dims, dims, supply);
+    UlmGridSolver<StaticGraph> staticS(staticGraph);
+    staticS.run();
+
+    // Test with statistics, one entry per level
+    Graph statsGraph(dims, dims, supply);
+    StatsSolver statsS(statsGraph);
+    statsS.run();
+    const auto& stats = statsS.statistics();
+    assert(int(stats.size()) == utils::hierarchicalDepth(dims, dims, 2) + 1);
+    for (const utils::SolverStatistics& level : stats) {
+      // All but the coarsest level start from the prolonged flow
+      assert(level.warm_start == (&level != &stats.front()));
+      assert(level.degenerate_pivots <= level.pivots);
+      assert(level.search_length >= level.pivots);
+      assert(int(level.densities.size()) ==
+             1 + level.shield_rebuilds + level.shield_updates);
+    }
+    assert(stats.back().pivots > 0);
+
     // Bookkeeping
     assert(r.objective_value == t.objective_value);
+    assert(r.objective_value == implicitS.totalCost());
+    assert(r.objective_value == incrementalS.totalCost());
+    assert(r.objective_value == reusedS.totalCost());
+    assert(r.objective_value == threadedS.totalCost());
+    assert(r.objective_value == statsS.totalCost());
+    assert(r.objective_value == staticS.totalCost());
     t_ref += r.t_ms;
     t_test += t.t_ms;
     ok &= r.objective_value == t.objective_value;
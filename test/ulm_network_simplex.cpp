@@ -24,6 +24,10 @@ using CostArcMap = typename Graph::CostArcMap;
 using Ref = NetworkSimplex<Graph, Value, Cost>;
 using Test = UlmNetworkSimplex<Graph, Value, Cost>;
 
+// The grid graph is solved without node and arc maps for the internal ids
+static_assert(IdentityIds<Graph>::value);
+static_assert(!IdentityIds<SmartBpDigraph>::value);
+
 TEMPLATE_BPDIGRAPH_TYPEDEFS(Graph);
 
 /// \brief Set LB and UB for feasible flow in the GEQ problem
@@ -116,6 +120,25 @@ void testSolver(Graph& graph, SupplyNodeMap& supplyMap, CostArcMap& costMap,
   }
 }
 
+/// \brief Test the uncapacitated variant with all pivot rules
+void testUncapacitated(Graph& graph, SupplyNodeMap& supplyMap,
+                       CostArcMap& costMap) {
+  using Uncap = UlmNetworkSimplex<Graph, Value, Cost, utils::NoStatistics,
+                                  false>;
+  Ref ref(graph);
+  Uncap test(graph);
+  const int r = ref.supplyMap(supplyMap).costMap(costMap).run();
+  for (const auto rule : {Uncap::FIRST_ELIGIBLE, Uncap::BEST_ELIGIBLE,
+                          Uncap::BLOCK_SEARCH, Uncap::CANDIDATE_LIST,
+                          Uncap::ALTERING_LIST}) {
+    test.reset().supplyMap(supplyMap).costMap(costMap);
+    if (test.run(rule) != r || ref.totalCost() != test.totalCost()) {
+      fmt::printf("Bug in uncapacitated pivot rule %d\n", rule);
+      std::abort();
+    }
+  }
+}
+
 void testSolverWithBounds(Graph& graph, SupplyNodeMap& supplyMap,
                           CostArcMap& costMap, IntArcMap& lowerMap,
                           IntArcMap& upperMap, Ref::SupplyType refSupplyType,
@@ -237,6 +260,89 @@ void testSolverWithBounds(Graph& graph, SupplyNodeMap& supplyMap,
   }
 }
 
+/// \brief Test warm starts from an optimal, a perturbed and an invalid start
+void testWarmStart(Graph& graph, SupplyNodeMap& supplyMap,
+                   CostArcMap& costMap) {
+  Ref ref(graph);
+  Test test(graph);
+  ref.supplyMap(supplyMap).costMap(costMap).run();
+  test.supplyMap(supplyMap).costMap(costMap).run();
+
+  IntArcMap flow(graph);
+  IntNodeMap potential(graph);
+  BoolArcMap basis(graph);
+  test.flowMap(flow);
+  test.potentialMap(potential);
+  test.basisMap(basis);
+
+  // Restart from the optimal solution
+  Test warm(graph);
+  warm.supplyMap(supplyMap).costMap(costMap).warmStart(flow, potential);
+  if (warm.run() != Test::OPTIMAL || ref.totalCost() != warm.totalCost() ||
+      !warm.warmStarted()) {
+    fmt::printf("Bug in warm start from flow and potentials\n");
+    std::abort();
+  }
+  for (NodeIt n(graph); n != INVALID; ++n) {
+    if (warm.potential(n) != potential[n]) {
+      fmt::printf("Bug in warm start potentials\n");
+      std::abort();
+    }
+  }
+
+  warm.reset().supplyMap(supplyMap).costMap(costMap).warmStart(flow);
+  if (warm.run(Test::FIRST_ELIGIBLE) != Test::OPTIMAL ||
+      ref.totalCost() != warm.totalCost()) {
+    fmt::printf("Bug in warm start from flow\n");
+    std::abort();
+  }
+
+  // A flow that misses the supplies attaches components with a deficit by
+  // artificial arcs with flow
+  IntArcMap zero(graph, 0);
+  warm.reset().supplyMap(supplyMap).costMap(costMap).warmStart(zero,
+                                                              potential);
+  if (warm.run() != Test::OPTIMAL || ref.totalCost() != warm.totalCost()) {
+    fmt::printf("Bug in warm start from an infeasible flow\n");
+    std::abort();
+  }
+
+  // Potential hints only change the start
+  warm.reset().supplyMap(supplyMap).costMap(costMap).potentialHint(potential);
+  if (warm.run() != Test::OPTIMAL || ref.totalCost() != warm.totalCost()) {
+    fmt::printf("Bug in potential hint\n");
+    std::abort();
+  }
+
+  // Re-solve with perturbed costs from the old basis
+  IntArcMap perturbed(graph);
+  std::uniform_int_distribution<Cost> noise(0, 10);
+  for (ArcIt a(graph); a != INVALID; ++a) perturbed[a] = costMap[a] + noise(mt);
+  ref.reset().supplyMap(supplyMap).costMap(perturbed).run();
+  warm.reset().supplyMap(supplyMap).costMap(perturbed).warmStartBasis(basis);
+  if (warm.run() != Test::OPTIMAL || ref.totalCost() != warm.totalCost()) {
+    fmt::printf("Bug in warm start with perturbed costs\n");
+    std::abort();
+  }
+
+  // Invalid flows fall back to a cold start
+  const Cost opt = test.totalCost();
+  for (ArcIt a(graph); a != INVALID; ++a) flow[a] = -flow[a];
+  warm.reset().supplyMap(supplyMap).costMap(costMap).warmStart(flow);
+  if (warm.run() != Test::OPTIMAL || opt != warm.totalCost() ||
+      warm.warmStarted()) {
+    fmt::printf("Bug in warm start fallback\n");
+    std::abort();
+  }
+
+  // The shielded pivot rule modifies the graph, hence it comes last
+  warm.reset().supplyMap(supplyMap).costMap(costMap).warmStartBasis(basis);
+  if (warm.runShielded() != Test::OPTIMAL || opt != warm.totalCost()) {
+    fmt::printf("Bug in warm start from basis\n");
+    std::abort();
+  }
+}
+
 int main(int argc, char** argv) {
   // Dimensions of grid
   Int2Array muXdim = {ULMON_GRID_DIM, ULMON_GRID_DIM};
@@ -262,6 +368,7 @@ int main(int argc, char** argv) {
 
   // test solvers without LB/UB
   testSolver(graph, supplyMap, costMap, Ref::GEQ, Test::GEQ);
+  testUncapacitated(graph, supplyMap, costMap);
 
   // test solvers with LB/UB
   IntArcMap lowerMap(graph);
@@ -270,6 +377,9 @@ int main(int argc, char** argv) {
   testSolverWithBounds(graph, supplyMap, costMap, lowerMap, upperMap, Ref::GEQ,
                        Test::GEQ);
 
+  // test warm starts (modifies the graph)
+  testWarmStart(graph, supplyMap, costMap);
+
   // ---------------- sum supplies < 0 (GEQ) -----------------------------
   ValueVector supplyG = supply;
   for (auto& sup : supplyG) {
@@ -282,6 +392,7 @@ int main(int argc, char** argv) {
 
   // test solvers without LB/UB
   testSolver(graphG, supplyMapG, costMapG, Ref::GEQ, Test::GEQ);
+  testUncapacitated(graphG, supplyMapG, costMapG);
 
   // test solvers with LB/UB
   IntArcMap lowerMapG(graphG);
@@ -302,6 +413,7 @@ int main(int argc, char** argv) {
 
   // test solvers without LB/UB
   testSolver(graphL, supplyMapL, costMapL, Ref::GEQ, Test::GEQ);
+  testUncapacitated(graphL, supplyMapL, costMapL);
 
   // test solvers with LB/UB
   IntArcMap lowerMapL(graphL);
@@ -321,6 +433,10 @@ int main(int argc, char** argv) {
 
   // test solvers without LB/UB
   testSolver(graphSparse, supplyMapSparse, costMapSparse, Ref::GEQ, Test::GEQ);
+  testUncapacitated(graphSparse, supplyMapSparse, costMapSparse);
+
+  // test warm starts (modifies the graph)
+  testWarmStart(graphSparse, supplyMapSparse, costMapSparse);
 
   fmt::printf("Okay\n");
   return 0;
@@ -24,8 +24,11 @@
 ///\brief SmartDigraph and SmartGraph classes.
 
 #include <ulmon/bits/bpdigraph_extender.h>
+#include <ulmon/utils/exceptions.h>
 
 #include <cassert>
+#include <cstdint>
+#include <limits>
 #include <vector>
 
 namespace lemon {
@@ -61,6 +64,11 @@ class SmartBpDigraphBase {
  public:
   typedef SmartBpDigraphBase Graph;
 
+  /// Arc ids are \c int like in all LEMON graphs, so at most this many arcs
+  /// can be added. Counts of potential arcs, e.g. of a complete bipartite
+  /// graph on large grids, may exceed it and should be 64-bit.
+  static constexpr std::int64_t MAX_ARC_NUM = std::numeric_limits<int>::max();
+
   class Node;
   class Arc;
 
@@ -231,6 +239,7 @@ class SmartBpDigraphBase {
   BlueNode blueNode(int index) const { return BlueNode(index + _red_num); }
 
   Arc addArc(RedNode u, BlueNode v) {
+    assert(static_cast<std::int64_t>(_arcs.size()) < MAX_ARC_NUM);
     int n = _arcs.size();
     _arcs.emplace_back();
     _arcs[n].source = u._id;
@@ -242,6 +251,36 @@ class SmartBpDigraphBase {
     return Arc(n);
   }
 
+  /// \brief Appends \c n arcs without ends and returns the id of the first
+  ///
+  /// The ends are set by \ref setArc(), possibly concurrently, and then the
+  /// arcs are linked by \ref linkArcs(). Together, this is equivalent to
+  /// adding the arcs in the order of their ids.
+  int growArcs(const int n) {
+    assert(static_cast<std::int64_t>(_arcs.size()) + n <= MAX_ARC_NUM);
+    const int first = _arcs.size();
+    _arcs.resize(first + n);
+    return first;
+  }
+
+  void setArc(const int id, RedNode u, BlueNode v) {
+    _arcs[id].source = u._id;
+    _arcs[id].target = v._id;
+  }
+
+  /// \brief Links the arcs with ids in [first, arcNum()) that were appended
+  /// by \ref growArcs()
+  void linkArcs(const int first) {
+    const int m = _arcs.size();
+    for (int n = first; n < m; ++n) {
+      ArcT& arc = _arcs[n];
+      arc.next_out = _red_nodes[arc.source].first_out;
+      arc.next_in = _blue_nodes[arc.target - _red_num].first_in;
+      _red_nodes[arc.source].first_out = n;
+      _blue_nodes[arc.target - _red_num].first_in = n;
+    }
+  }
+
   void clear() {
     _node_num = _red_num = _blue_num = 0;
     _red_nodes.clear();
@@ -334,7 +373,12 @@ class SmartBpDigraph : public ExtendedSmartBpDigraphBase {
   /// be large (e.g. it will contain millions of nodes and/or arcs),
   /// then it is worth reserving space for this amount before starting
   /// to build the graph.
-  void reserveArcs(int m) { _arcs.reserve(m); };
+  ///
+  /// \throws utils::ArcOverflowError if \c m exceeds \ref MAX_ARC_NUM
+  void reserveArcs(const std::int64_t m) {
+    if (m > MAX_ARC_NUM) throw utils::ArcOverflowError();
+    _arcs.reserve(m);
+  };
 };
 
 }  // namespace lemon
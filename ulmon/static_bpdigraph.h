@@ -0,0 +1,451 @@
+/* -*- mode: C++; indent-tabs-mode: nil; -*-
+ *
+ * This file is a part of LEMON, a generic C++ optimization library.
+ *
+ * Copyright (C) 2003-2013
+ * Egervary Jeno Kombinatorikus Optimalizalasi Kutatocsoport
+ * (Egervary Research Group on Combinatorial Optimization, EGRES).
+ *
+ * Permission to use, modify and distribute this software is granted
+ * provided that this copyright notice appears in all copies. For
+ * precise terms see the accompanying LICENSE file.
+ *
+ * This software is provided "AS IS" with no warranty of any kind,
+ * express or implied, and with no claim as to its suitability for any
+ * purpose.
+ *
+ */
+
+#ifndef ULMON_STATIC_BPDIGRAPH_H
+#define ULMON_STATIC_BPDIGRAPH_H
+
+///\ingroup graphs
+///\file
+///\brief StaticBpDigraph class.
+
+#include <ulmon/bits/bpdigraph_extender.h>
+#include <ulmon/utils/exceptions.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace lemon {
+
+class StaticBpDigraphBase {
+ protected:
+  int _red_num;
+  int _blue_num;
+  int _node_num;
+
+  // Arcs
+  std::vector<int> _source;
+  std::vector<int> _target;
+
+  // Out arcs. While the arcs are grouped by source, the arcs of red node x
+  // are [_first_out[x], _first_out[x + 1]) for x < _last_red and
+  // [_first_out[_last_red], arcNum()) for _last_red. Otherwise, _first_out
+  // and _next_out form linked lists.
+  std::vector<int> _first_out;
+  std::vector<int> _next_out;
+  int _last_red;
+  bool _grouped;
+
+  // In arcs, linked lists that are extended on demand by firstIn()
+  mutable std::vector<int> _first_in;
+  mutable std::vector<int> _next_in;
+  mutable int _in_num;
+
+ public:
+  typedef StaticBpDigraphBase Graph;
+
+  /// Arc ids are \c int like in all LEMON graphs, see
+  /// \ref SmartBpDigraphBase::MAX_ARC_NUM
+  static constexpr std::int64_t MAX_ARC_NUM = std::numeric_limits<int>::max();
+
+  class Node;
+  class Arc;
+
+  class Node {
+    friend class StaticBpDigraphBase;
+
+   protected:
+    int _id;
+    explicit Node(int id) { _id = id; }
+
+   public:
+    Node() {}
+    Node(Invalid) { _id = -1; }
+    bool operator==(const Node& node) const { return _id == node._id; }
+    bool operator!=(const Node& node) const { return _id != node._id; }
+    bool operator<(const Node& node) const { return _id < node._id; }
+  };
+
+  class RedNode : public Node {
+    friend class StaticBpDigraphBase;
+
+   protected:
+    explicit RedNode(int pid) : Node(pid) {}
+
+   public:
+    RedNode() {}
+    RedNode(const RedNode& node) : Node(node) {}
+    RedNode(Invalid) : Node(INVALID) {}
+    const RedNode& operator=(const RedNode& node) {
+      Node::operator=(node);
+      return *this;
+    }
+  };
+
+  class BlueNode : public Node {
+    friend class StaticBpDigraphBase;
+
+   protected:
+    explicit BlueNode(int pid) : Node(pid) {}
+
+   public:
+    BlueNode() {}
+    BlueNode(const BlueNode& node) : Node(node) {}
+    BlueNode(Invalid) : Node(INVALID) {}
+    const BlueNode& operator=(const BlueNode& node) {
+      Node::operator=(node);
+      return *this;
+    }
+  };
+
+  class Arc {
+    friend class StaticBpDigraphBase;
+
+   protected:
+    int _id;
+    explicit Arc(int id) { _id = id; }
+
+   public:
+    Arc() {}
+    Arc(Invalid) { _id = -1; }
+    bool operator==(const Arc& arc) const { return _id == arc._id; }
+    bool operator!=(const Arc& arc) const { return _id != arc._id; }
+    bool operator<(const Arc& arc) const { return _id < arc._id; }
+  };
+
+  StaticBpDigraphBase()
+      : _red_num(0),
+        _blue_num(0),
+        _node_num(0),
+        _last_red(-1),
+        _grouped(true),
+        _in_num(0) {}
+
+  void construct(const int red_num, const int blue_num) {
+    _red_num = red_num;
+    _blue_num = blue_num;
+    _node_num = red_num + blue_num;
+
+    _first_out.resize(red_num + 1, -1);
+    _first_in.resize(blue_num, -1);
+  }
+
+  typedef True NodeNumTag;
+  typedef True ArcNumTag;
+
+  int nodeNum() const { return _node_num; }
+  int redNum() const { return _red_num; }
+  int blueNum() const { return _blue_num; }
+  int arcNum() const { return _source.size(); }
+
+  int maxNodeId() const { return _node_num - 1; }
+  int maxRedId() const { return _red_num - 1; }
+  int maxBlueId() const { return _blue_num - 1; }
+  int maxArcId() const { return _source.capacity() - 1; }
+
+  bool red(Node n) const { return n._id < _red_num; }
+  bool blue(Node n) const { return n._id >= _red_num; }
+
+  static RedNode asRedNodeUnsafe(Node n) { return RedNode(n._id); }
+  static BlueNode asBlueNodeUnsafe(Node n) { return BlueNode(n._id); }
+
+  Node source(Arc a) const { return Node(_source[a._id]); }
+  RedNode source(Arc a, RedNode) const {
+    Node n = source(a);
+    assert(red(n));
+    return asRedNodeUnsafe(n);
+  }
+
+  Node target(Arc a) const { return Node(_target[a._id]); }
+  BlueNode target(Arc a, BlueNode) const {
+    Node n = target(a);
+    assert(blue(n));
+    return asBlueNodeUnsafe(n);
+  }
+
+  void first(Node& node) const { node._id = _node_num - 1; }
+
+  static void next(Node& node) { --node._id; }
+
+  void first(RedNode& node) const { node._id = _red_num - 1; }
+
+  void next(RedNode& node) const { --node._id; }
+
+  void first(BlueNode& node) const {
+    if (_blue_num == 0)
+      node._id = -1;
+    else
+      node._id = _node_num - 1;
+  }
+
+  void next(BlueNode& node) const {
+    if (node._id == _red_num)
+      node._id = -1;
+    else
+      --node._id;
+  }
+
+  void first(Arc& arc) const { arc._id = _source.size() - 1; }
+
+  static void next(Arc& arc) { --arc._id; }
+
+  // Out arcs are traversed in decreasing order as in SmartBpDigraph
+  void firstOut(Arc& arc, const Node& v) const {
+    const int x = v._id;
+    if (x >= _red_num) {
+      arc._id = -1;
+    } else if (!_grouped) {
+      arc._id = _first_out[x];
+    } else if (x > _last_red) {
+      arc._id = -1;
+    } else {
+      const int end = x == _last_red ? arcNum() : _first_out[x + 1];
+      arc._id = end > _first_out[x] ? end - 1 : -1;
+    }
+  }
+  void nextOut(Arc& arc) const {
+    if (!_grouped) {
+      arc._id = _next_out[arc._id];
+    } else {
+      const int x = _source[arc._id];
+      arc._id = arc._id > _first_out[x] ? arc._id - 1 : -1;
+    }
+  }
+
+  void firstIn(Arc& arc, const Node& v) const {
+    if (v._id >= _red_num) {
+      buildIn();
+      arc._id = _first_in[v._id - _red_num];
+    } else {
+      arc._id = -1;
+    }
+  }
+  void nextIn(Arc& arc) const { arc._id = _next_in[arc._id]; }
+
+  static int id(Node v) { return v._id; }
+  int id(RedNode v) const { return v._id; }
+  int id(BlueNode v) const { return v._id - _red_num; }
+  static int id(Arc e) { return e._id; }
+
+  static Node nodeFromId(int id) { return Node(id); }
+  static Arc arcFromId(int id) { return Arc(id); }
+
+  bool valid(Node n) const { return n._id >= 0 && n._id < _node_num; }
+  bool valid(RedNode n) const { return n._id >= 0 && n._id < _red_num; }
+  bool valid(BlueNode n) const { return n._id >= _red_num && n._id < _node_num; }
+  bool valid(Arc a) const { return a._id >= 0 && a._id < arcNum(); }
+
+  RedNode redNode(int index) const { return RedNode(index); }
+  BlueNode blueNode(int index) const { return BlueNode(index + _red_num); }
+
+  /// \brief Whether the arcs are grouped by source, i.e. the out arcs are
+  /// stored without links
+  bool grouped() const { return _grouped; }
+
+  Arc addArc(RedNode u, BlueNode v) {
+    assert(static_cast<std::int64_t>(_source.size()) < MAX_ARC_NUM);
+    const int n = _source.size();
+    const int x = u._id;
+    if (_grouped && x < _last_red) ungroup();
+
+    _source.push_back(x);
+    _target.push_back(v._id);
+    if (!_grouped) {
+      _next_out.push_back(_first_out[x]);
+      _first_out[x] = n;
+    } else {
+      for (; _last_red < x; ++_last_red) _first_out[_last_red + 1] = n;
+    }
+    return Arc(n);
+  }
+
+  /// \brief Appends \c n arcs without ends and returns the id of the first,
+  /// see \ref SmartBpDigraphBase::growArcs()
+  int growArcs(const int n) {
+    assert(static_cast<std::int64_t>(_source.size()) + n <= MAX_ARC_NUM);
+    const int first = _source.size();
+    _source.resize(first + n);
+    _target.resize(first + n);
+    return first;
+  }
+
+  void setArc(const int id, RedNode u, BlueNode v) {
+    _source[id] = u._id;
+    _target[id] = v._id;
+  }
+
+  /// \brief Links the arcs with ids in [first, arcNum()) that were appended
+  /// by \ref growArcs()
+  void linkArcs(const int first) {
+    const int m = arcNum();
+    if (_grouped) {
+      int a = first;
+      for (; a < m && _source[a] >= _last_red; ++a) {
+        for (; _last_red < _source[a]; ++_last_red) {
+          _first_out[_last_red + 1] = a;
+        }
+      }
+      if (a == m) return;
+      ungroup();  // Links all arcs
+    } else {
+      _next_out.resize(m);
+      for (int a = first; a < m; ++a) {
+        _next_out[a] = _first_out[_source[a]];
+        _first_out[_source[a]] = a;
+      }
+    }
+  }
+
+  void clear() {
+    _node_num = _red_num = _blue_num = 0;
+    _first_out.clear();
+    _first_in.clear();
+    clearArcs();
+  }
+
+  void clearArcs() {
+    _source.clear();
+    _target.clear();
+    _next_out.clear();
+    _next_in.clear();
+    std::fill(_first_out.begin(), _first_out.end(), -1);
+    std::fill(_first_in.begin(), _first_in.end(), -1);
+    _last_red = -1;
+    _grouped = true;
+    _in_num = 0;
+  }
+
+ protected:
+  void reserve(const std::int64_t m) {
+    _source.reserve(m);
+    _target.reserve(m);
+    if (!_grouped) _next_out.reserve(m);
+  }
+
+ private:
+  // Switches from ranges to linked lists for the out arcs
+  void ungroup() {
+    const int m = arcNum();
+    _next_out.reserve(_source.capacity());
+    _next_out.resize(m);
+    std::fill(_first_out.begin(), _first_out.end(), -1);
+    for (int a = 0; a < m; ++a) {
+      _next_out[a] = _first_out[_source[a]];
+      _first_out[_source[a]] = a;
+    }
+    _grouped = false;
+  }
+
+  // Links the arcs added since the last call into the in arc lists
+  void buildIn() const {
+    const int m = arcNum();
+    if (_in_num == m) return;
+    _next_in.resize(m);
+    for (int a = _in_num; a < m; ++a) {
+      int& first = _first_in[_target[a] - _red_num];
+      _next_in[a] = first;
+      first = a;
+    }
+    _in_num = m;
+  }
+};
+
+typedef BpDigraphExtender<StaticBpDigraphBase> ExtendedStaticBpDigraphBase;
+
+/// \ingroup graphs
+///
+/// \brief A compact directed bipartite graph class.
+///
+/// \ref StaticBpDigraph has the same interface as \ref SmartBpDigraph, but
+/// stores the arcs in compressed sparse row format. As long as the arcs are
+/// added grouped by their red node, e.g. in the order of the red nodes, an
+/// arc takes 8 bytes instead of 16 and its out arcs are contiguous. Adding
+/// an arc out of this order switches to linked lists for the out arcs,
+/// which takes 4 more bytes per arc. The in arcs are linked on demand when
+/// they are traversed first, which also takes 4 bytes per arc.
+///
+/// This type fully conforms to the \ref concepts::BpDigraph "BpDigraph concept"
+/// and traverses all items in the same order as \ref SmartBpDigraph.
+///
+/// \warning In arc traversal is not thread safe if arcs were added since the
+/// last traversal.
+///
+/// \sa concepts::BpDigraph
+/// \sa SmartBpDigraph
+class StaticBpDigraph : public ExtendedStaticBpDigraphBase {
+  typedef ExtendedStaticBpDigraphBase Parent;
+
+ private:
+  /// Graphs are \e not copy constructible. Use GraphCopy instead.
+  StaticBpDigraph(const StaticBpDigraph&) : ExtendedStaticBpDigraphBase(){};
+  /// \brief Assignment of a graph to another one is \e not allowed.
+  /// Use GraphCopy instead.
+  void operator=(const StaticBpDigraph&) {}
+
+ public:
+  /// Constructor.
+  StaticBpDigraph() {}
+
+  /// @brief Constructor.
+
+  /// @param red_num Number of red nodes
+  /// @param blue_num Number of blue nodes
+  StaticBpDigraph(const int red_num, const int blue_num) {
+    construct(red_num, blue_num);
+  }
+
+  /// \brief Add a new arc to the graph.
+  ///
+  /// This function adds a new arc to the graph from red node
+  /// \c u to blue node \c v.
+  /// \return The new arc.
+  Arc addArc(RedNode u, BlueNode v) {
+    assert(valid(u));
+    assert(valid(v));
+    Arc a = Parent::addArc(u, v);
+    notifier(a).build();
+    return a;
+  }
+
+  /// \warning Call notifier(Arc()).build() after adding all arcs
+  Arc addArcLazily(RedNode u, BlueNode v) { return Parent::addArc(u, v); }
+
+  /// Clear the graph.
+
+  /// This function erases all nodes and arcs from the graph.
+  void clear() { Parent::clear(); }
+
+  void clearArcs() {
+    notifier(Arc()).clear();
+    Parent::clearArcs();
+  }
+
+  /// Reserve memory for arcs.
+
+  /// \throws utils::ArcOverflowError if \c m exceeds \ref MAX_ARC_NUM
+  void reserveArcs(const std::int64_t m) {
+    if (m > MAX_ARC_NUM) throw utils::ArcOverflowError();
+    reserve(m);
+  };
+};
+
+}  // namespace lemon
+
+#endif  // ULMON_STATIC_BPDIGRAPH_H
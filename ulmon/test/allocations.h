@@ -0,0 +1,44 @@
+#ifndef ULMON_TEST_ALLOCATIONS_H
+#define ULMON_TEST_ALLOCATIONS_H
+
+// Counts the heap allocations of the program by replacing the global
+// operator new. Include this header in exactly one translation unit.
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace lemon {
+
+namespace test {
+
+/// \brief Number of heap allocations since the start of the program
+inline std::atomic<long> allocations{0};
+
+};  // namespace test
+
+};  // namespace lemon
+
+void* operator new(std::size_t size) {
+  ++lemon::test::allocations;
+  if (void* p = std::malloc(size ? size : 1)) return p;
+  throw std::bad_alloc();
+}
+
+// The replaced operator new allocates with malloc, hence free is the matching
+// deallocation. GCC inlines the operators, takes the pointer for one of the
+// builtin operator new and warns about the free.
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+void operator delete(void* p) noexcept { std::free(p); }
+
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11
+#pragma GCC diagnostic pop
+#endif
+
+#endif
@@ -0,0 +1,186 @@
+#ifndef ULMON_ULM_DISTANCE_MATRIX_H
+#define ULMON_ULM_DISTANCE_MATRIX_H
+
+#include <ulmon/core.h>
+#include <ulmon/ulm_grid_solver.h>
+#include <ulmon/utils/grid.h>
+#include <ulmon/utils/thread_pool.h>
+#include <ulmon/utils/view.h>
+
+#include <atomic>
+#include <cassert>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace lemon {
+
+/// \brief Optimal transport costs between all pairs of marginals on one grid
+///
+/// If the source and the target grid are the same and the metric is
+/// symmetric, e.g. \c SquaredEuclidean, the optimal cost from marginal i to
+/// marginal j equals the one from j to i, and the optimal plan of one
+/// direction is the transpose of the other. Hence \ref run() solves each
+/// unordered pair only once, and \ref plan() derives the plan of the reversed
+/// direction.
+///
+/// \tparam GR The grid graph type, its metric must be symmetric
+/// \tparam TC The number type of the total costs
+template <typename GR, typename TC = long>
+class UlmDistanceMatrix {
+ public:
+  using Solver = UlmGridSolver<GR>;
+  using ProblemType = typename Solver::ProblemType;
+  using TotalCost = TC;
+
+ private:
+  TEMPLATE_BPDIGRAPH_TYPEDEFS(GR);
+
+  using Value = typename GR::Value;
+  using ValueVector = std::vector<Value>;
+  using ValueView = typename GR::ValueView;
+  using IntDimArray = typename GR::IntDimArray;
+
+  // Graph and solver, one per thread
+  struct Context {
+    GR graph;
+    Solver solver;
+
+    Context(const IntDimArray& dim, const int merge_num)
+        : graph(dim, dim, ValueVector(2 * utils::numNodes(dim), 0)),
+          solver(graph, merge_num) {}
+  };
+
+  const IntDimArray _dim;
+  const int _merge_num;
+  const std::vector<ValueView> _marginals;
+  const int _n;
+  std::vector<TotalCost> _distance;  // Row-major n x n matrix
+
+  std::unique_ptr<utils::ThreadPool> _pool;
+  std::vector<std::unique_ptr<Context>> _contexts;  // Unused contexts
+  std::mutex _mutex;                                // Guards _contexts
+
+ public:
+  /// \brief Constructor
+  ///
+  /// \param dim Number of points per dimension of the grid
+  /// \param marginals Nonnegative marginals with equal sums, which are viewed
+  /// without copying them
+  /// \param merge_num Merge number of the multiscale solver
+  UlmDistanceMatrix(const IntDimArray& dim, std::vector<ValueView> marginals,
+                    const int merge_num = 2)
+      : _dim(dim),
+        _merge_num(merge_num),
+        _marginals(std::move(marginals)),
+        _n(_marginals.size()),
+        _distance(std::size_t(_n) * _n, 0) {}
+
+  /// \brief Sets the number of threads that solve pairs in parallel
+  UlmDistanceMatrix& threads(const int num_threads) {
+    if (num_threads > 1)
+      _pool = std::make_unique<utils::ThreadPool>(num_threads);
+    else
+      _pool.reset();
+    return *this;
+  }
+
+  /// \brief Computes the distances of all pairs, solving each unordered pair
+  /// once
+  ///
+  /// \return \c OPTIMAL if all pairs are solved to optimality, otherwise the
+  /// problem type of a failed pair
+  ProblemType run() {
+    std::vector<std::pair<int, int>> pairs;
+    pairs.reserve(std::size_t(_n) * (_n - 1) / 2);
+    for (int i = 0; i < _n; ++i) {
+      for (int j = i + 1; j < _n; ++j) pairs.emplace_back(i, j);
+    }
+
+    // Each pair writes its own two entries
+    std::atomic<int> result{Solver::NetSimplex::OPTIMAL};
+    auto body = [&](const int k) {
+      const auto [i, j] = pairs[k];
+      std::unique_ptr<Context> context = acquire();
+      Solver& solver = context->solver;
+      const ProblemType r = solver.solve(_marginals[i], _marginals[j]);
+      const TotalCost c = solver.template totalCost<TotalCost>();
+      _distance[std::size_t(i) * _n + j] = c;
+      _distance[std::size_t(j) * _n + i] = c;
+      release(std::move(context));
+      if (r != Solver::NetSimplex::OPTIMAL) result = r;
+    };
+    if (_pool) {
+      _pool->run(pairs.size(), body);
+    } else {
+      for (int k = 0; k < int(pairs.size()); ++k) body(k);
+    }
+    return ProblemType(result.load());
+  }
+
+  /// \brief Calls <tt>f(x, y, v)</tt> for the positive amounts \c v of an
+  /// optimal plan from marginal i to marginal j, where \c x and \c y are the
+  /// indices of the grid points
+  ///
+  /// Only the pair with the smaller index first is solved, the plan of the
+  /// other direction is its transpose.
+  template <typename F>
+  ProblemType plan(int i, int j, F f) {
+    const bool transpose = i > j;
+    if (transpose) std::swap(i, j);
+
+    std::unique_ptr<Context> context = acquire();
+    const GR& graph = context->graph;
+    Solver& solver = context->solver;
+    const ProblemType r = solver.solve(_marginals[i], _marginals[j]);
+    if (r == Solver::NetSimplex::OPTIMAL) {
+      for (ArcIt a(graph); a != INVALID; ++a) {
+        const Value v = solver.flow(a);
+        if (!v) continue;
+        const int x = graph.id(graph.source(a, RedNode{}));
+        const int y = graph.id(graph.target(a, BlueNode{}));
+        if (transpose)
+          f(y, x, v);
+        else
+          f(x, y, v);
+      }
+    }
+    release(std::move(context));
+    return r;
+  }
+
+  /// \brief Number of marginals
+  int size() const { return _n; }
+
+  /// \brief Optimal cost from marginal i to marginal j after \ref run()
+  TotalCost distance(const int i, const int j) const {
+    return _distance[std::size_t(i) * _n + j];
+  }
+
+  /// \brief Dense distance matrix after \ref run(), row by row
+  const std::vector<TotalCost>& matrix() const { return _distance; }
+
+ private:
+  // Takes an unused context, or creates one for a new thread
+  std::unique_ptr<Context> acquire() {
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      if (!_contexts.empty()) {
+        std::unique_ptr<Context> context = std::move(_contexts.back());
+        _contexts.pop_back();
+        return context;
+      }
+    }
+    return std::make_unique<Context>(_dim, _merge_num);
+  }
+
+  void release(std::unique_ptr<Context> context) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _contexts.push_back(std::move(context));
+  }
+};
+
+};  // namespace lemon
+
+#endif
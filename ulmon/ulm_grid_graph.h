@@ -3,11 +3,18 @@
 
 #include <ulmon/core.h>
 #include <ulmon/smart_bpdigraph.h>
+#include <ulmon/static_bpdigraph.h>
 #include <ulmon/utils/grid.h>
 #include <ulmon/utils/metric.h>
+#include <ulmon/utils/radix_sort.h>
+#include <ulmon/utils/thread_pool.h>
+#include <ulmon/utils/trace.h>
+#include <ulmon/utils/view.h>
 
+#include <algorithm>
 #include <array>
 #include <cassert>
+#include <cstdint>
 #include <functional>
 #include <numeric>
 #include <vector>
@@ -24,14 +31,38 @@ namespace lemon {
 /// \param int D Grid dimension
 /// \tparam M The metric class used to compute distances.
 /// By default, it is \c SquaredEuclidean<C, D>.
+/// \tparam BG The underlying bipartite digraph, \ref SmartBpDigraph or
+/// \ref StaticBpDigraph. By default, it is \c SmartBpDigraph.
 ///
 /// \warning \c V and \c C must be a signed number type.
 template <typename V = int, typename C = V, int D = 2,
-          typename M = SquaredEuclidean<C, D>>
-class UlmGridGraph : public SmartBpDigraph {
-  using Graph = UlmGridGraph<V, C, D, M>;
+          typename M = SquaredEuclidean<C, D>, typename BG = SmartBpDigraph>
+class UlmGridGraph : public BG {
+  using Graph = UlmGridGraph<V, C, D, M, BG>;
+
+ protected:
+  using Parent = BG;
+  using Parent::_blue_num;
+  using Parent::_node_num;
+  using Parent::_red_num;
 
  public:
+  using typename Parent::Arc;
+  using typename Parent::ArcIt;
+  using typename Parent::BlueNode;
+  using typename Parent::Node;
+  using typename Parent::RedNode;
+  using Parent::MAX_ARC_NUM;
+  using Parent::arcFromId;
+  using Parent::arcNum;
+  using Parent::blueNode;
+  using Parent::id;
+  using Parent::notifier;
+  using Parent::redNode;
+  using Parent::source;
+  using Parent::target;
+  using Parent::valid;
+
   // Type aliases
   using Value = V;
   using Cost = C;
@@ -40,15 +71,26 @@ class UlmGridGraph : public SmartBpDigraph {
 
   using IntDimArray = std::array<int, Dim>;
   using ValueVector = std::vector<Value>;
+  using ValueView = utils::ConstView<Value>;
   using CostVector = std::vector<Cost>;
   using PosVector = std::vector<IntDimArray>;
 
   using SupportVector = std::vector<std::pair<RedNode, BlueNode>>;
   using ArcVector = std::vector<Arc>;
 
+  // Arcs from the red nodes in [x_min, x_max) to the blue nodes in
+  // [y_min, y_max), see addArcBoxes()
+  struct ArcBox {
+    IntDimArray x_min, x_max, y_min, y_max;
+    int first_arc;  // Id of the first arc, set by addArcBoxes()
+  };
+
   // Shielded tag
   using ShieldedTag = True;
 
+  // Node ids are 0, ..., n-1 and arc ids are 0, ..., m-1, see IdentityIds
+  using IdentityIdTag = True;
+
   // Supply wrapper
   class SupplyNodeMap {
     const Graph& _g;
@@ -58,9 +100,9 @@ class UlmGridGraph : public SmartBpDigraph {
 
     V operator[](const Node v) const {
       assert(_g.valid(v));
-      const std::size_t i = _g.id(v);
-      assert(i < _g._supply.size());
-      return _g._supply[i];
+      const int i = _g.id(v);
+      if (i < _g._red_num) return _g._x_supply[i];
+      return -_g._y_demand[i - _g._red_num];
     }
   };
 
@@ -75,6 +117,7 @@ class UlmGridGraph : public SmartBpDigraph {
 
     C operator[](const Arc a) const {
       assert(_g.valid(a));
+      if (_g._implicit_cost) return _g.implicitCost(a);
       const std::size_t i = _g.id(a);
       assert(i < _g._cost.size());
       return _g._cost[i];
@@ -85,10 +128,12 @@ class UlmGridGraph : public SmartBpDigraph {
 
  protected:
   // Protected type aliases
-  using Parent = SmartBpDigraph;
   using CharVector = std::vector<signed char>;
   using IntVector = std::vector<int>;
 
+  // Chunks per thread in parallel arc construction for load balancing
+  constexpr static int CHUNKS_PER_THREAD = 8;
+
   // Graph data
  public:
   const IntDimArray _x_dim, _y_dim;
@@ -98,14 +143,24 @@ class UlmGridGraph : public SmartBpDigraph {
   PosVector _y_min, _y_max;
   PosVector _old_y_min, _old_y_max;
   PosVector _x_pos, _y_pos;
+  IntVector _shield_first;  // First arc id of each shield rectangle
+  std::vector<std::int64_t> _chunk_offset;  // See addShieldArcs()
+  utils::KeyedVector<int> _missing, _missing_scratch;  // See rebuildShield()
   bool _fully;
   const int _merge_num;
 
-  // Instance data
-  ValueVector _supply;
+  // Instance data, the marginals are views of _supply or of the memory of
+  // the caller, see setSupply()
+  ValueVector _supply;  // Supplies of the red, then demands of the blue nodes
+  ValueView _x_supply, _y_demand;
   CostVector _cost;
   Metric _metric;
 
+  // Implicit costs, see implicitCosts()
+  bool _implicit_cost{false};
+  IntVector _cost_key;
+  CostVector _cost_table;
+
  public:
   /// \brief Constructor 1, creates an explicit empty bipartite graph
   ///
@@ -126,12 +181,13 @@ class UlmGridGraph : public SmartBpDigraph {
         _x_pos(_red_num),
         _y_pos(_blue_num),
         _fully(fully),
-        _merge_num(0),
-        _supply(supply) /* Copy */ {
+        _merge_num(0) {
     initPos();
+    setSupply(supply);
     if (_fully) {
-      reserveArcs(_red_num * _blue_num);
-      addArcs();
+      reserveArcs(static_cast<std::int64_t>(_red_num) * _blue_num);
+      addShieldArcs();
+      buildArcs();
     } else {
       reserveArcs(ULMON_CONST_RESERVE * _node_num);
     }
@@ -159,14 +215,17 @@ class UlmGridGraph : public SmartBpDigraph {
         _x_pos(_red_num),
         _y_pos(_blue_num),
         _fully(false),
-        _merge_num(0),
-        _supply(supply) /* Copy */ {
+        _merge_num(0) {
     initPos();
+    setSupply(supply);
 
     assert(_y_min.size() == _red_num);
     assert(_y_max.size() == _red_num);
-    reserveArcs(ULMON_CONST_RESERVE * utils::numArcs(_y_min, _y_max));
-    addArcs();
+    reserveArcs(std::min(
+        ULMON_CONST_RESERVE * utils::numArcs<std::int64_t>(_y_min, _y_max),
+        MAX_ARC_NUM));
+    addShieldArcs();
+    buildArcs();
   }
 
   UlmGridGraph(const Graph& graph, const int merge_num)
@@ -185,39 +244,117 @@ class UlmGridGraph : public SmartBpDigraph {
         _x_pos(_red_num),
         _y_pos(_blue_num),
         _fully(false),
-        _merge_num(merge_num),
-        _supply(_node_num) {
+        _merge_num(merge_num) {
     initPos();
+    coarsen(graph);
+    reserveArcs(ULMON_CONST_RESERVE * _node_num);
+  }
 
+  /// \brief Constructor 4, creates an explicit empty bipartite graph that
+  /// views the marginals of the caller instead of copying them
+  ///
+  /// \param x_dim Number of points per dimension in source grid
+  /// \param y_dim Number of points per dimension in target grid
+  /// \param x_supply Supply of the red nodes
+  /// \param y_demand Demand of the blue nodes, i.e. nonnegative values
+  UlmGridGraph(const IntDimArray& x_dim, const IntDimArray& y_dim,
+               const ValueView x_supply, const ValueView y_demand,
+               const bool fully = false)
+      : Parent(utils::numNodes(x_dim), utils::numNodes(y_dim)),
+        _x_dim(x_dim),
+        _y_dim(y_dim),
+        _x_strides(utils::getStrides(_x_dim)),
+        _y_strides(utils::getStrides(_y_dim)),
+        _y_min(_red_num),
+        _y_max(_red_num, _y_dim),
+        _old_y_min(_red_num),
+        _old_y_max(_red_num, _y_dim),
+        _x_pos(_red_num),
+        _y_pos(_blue_num),
+        _fully(fully),
+        _merge_num(0) {
+    initPos();
+    setSupply(x_supply, y_demand);
+    if (_fully) {
+      reserveArcs(static_cast<std::int64_t>(_red_num) * _blue_num);
+      addShieldArcs();
+      buildArcs();
+    } else {
+      reserveArcs(ULMON_CONST_RESERVE * _node_num);
+    }
+  }
+
+  /// \brief Recomputes the supply from the finer graph, which has the shape
+  /// this graph was coarsened from, and clears the arcs
+  ///
+  /// The storage of the arcs and of the shield is kept, so a graph reused
+  /// for another supply on the same grids does not allocate again.
+  void coarsen(const Graph& graph) {
+    assert(_x_dim == utils::getCoarsenedGridDim(_merge_num, graph._x_dim));
+    assert(_y_dim == utils::getCoarsenedGridDim(_merge_num, graph._y_dim));
+    if (graph._implicit_cost != _implicit_cost)
+      implicitCosts(graph._implicit_cost);
+    clearArcs();
+
+    _supply.assign(_node_num, 0);
     IntDimArray pos{};
     for (int xx = 0; xx < graph._red_num; ++xx) {
-      utils::coarsenedPos(merge_num, graph._x_pos[xx], pos);
+      utils::coarsenedPos(_merge_num, graph._x_pos[xx], pos);
       int x = utils::idFromPos(pos, _x_strides);
-      _supply[x] += graph._supply[xx];
+      _supply[x] += graph._x_supply[xx];
     }
     for (int yy = 0; yy < graph._blue_num; ++yy) {
-      utils::coarsenedPos(merge_num, graph._y_pos[yy], pos);
+      utils::coarsenedPos(_merge_num, graph._y_pos[yy], pos);
       int y = utils::idFromPos(pos, _y_strides);
-      _supply[y + _red_num] += graph._supply[yy + graph._red_num];
+      _supply[y + _red_num] += graph._y_demand[yy];
     }
-    assert(std::reduce(_supply.begin(), _supply.end()) == 0);
+    viewSupply();
+    assert(std::reduce(_x_supply.begin(), _x_supply.end()) ==
+           std::reduce(_y_demand.begin(), _y_demand.end()));
+  }
 
-    reserveArcs(ULMON_CONST_RESERVE * _node_num);
+  /// \brief Replaces the supply / demand of the nodes by a copy, the arcs
+  /// are kept
+  ///
+  /// \param supply Supply / demand of nodes as in the constructors 1 and 2
+  void setSupply(const ValueVector& supply) {
+    assert(supply.size() == std::size_t(_node_num));
+    _supply.resize(_node_num);
+    std::copy(supply.begin(), supply.begin() + _red_num, _supply.begin());
+    std::transform(supply.begin() + _red_num, supply.end(),
+                   _supply.begin() + _red_num, std::negate<Value>());
+    viewSupply();
+  }
+
+  /// \brief Views the given marginals without copying them, the arcs are
+  /// kept
+  ///
+  /// The viewed memory must not change or go away while the graph is used.
+  ///
+  /// \param x_supply Supply of the red nodes
+  /// \param y_demand Demand of the blue nodes, i.e. nonnegative values
+  void setSupply(const ValueView x_supply, const ValueView y_demand) {
+    assert(x_supply.size() == std::size_t(_red_num));
+    assert(y_demand.size() == std::size_t(_blue_num));
+    _x_supply = x_supply;
+    _y_demand = y_demand;
   }
 
   /// \brief Clears the graph, reserves space, resets shield, and adds all arcs
   void addAllArcs() {
     clearArcs();
-    reserveArcs(_red_num * _blue_num);
+    reserveArcs(static_cast<std::int64_t>(_red_num) * _blue_num);
     resetShield();
-    addArcs();
+    addShieldArcs();
+    buildArcs();
     _fully = true;
   }
 
   /// \brief Adds the arc between x and y, computes cost
   Arc addArc(RedNode x, BlueNode y) {
     Arc a = Parent::addArc(x, y);
-    _cost.emplace_back(_metric(_x_pos[id(x)], _y_pos[id(y)]));
+    if (!_implicit_cost)
+      _cost.emplace_back(_metric(_x_pos[id(x)], _y_pos[id(y)]));
     return a;
   }
 
@@ -225,16 +362,56 @@ class UlmGridGraph : public SmartBpDigraph {
   /// \warning Call buildArcs after adding all arcs
   inline Arc addArcLazily(RedNode x, BlueNode y) {
     Arc a = Parent::addArcLazily(x, y);
-    _cost.emplace_back(_metric(_x_pos[id(x)], _y_pos[id(y)]));
+    if (!_implicit_cost)
+      _cost.emplace_back(_metric(_x_pos[id(x)], _y_pos[id(y)]));
     return a;
   }
 
+  /// \brief Switches between stored and implicit arc costs
+  ///
+  /// With implicit costs, the graph stores no cost per arc. Since the cost
+  /// of an arc only depends on the displacement of its end nodes, it is
+  /// looked up as <tt>costTable()[costKeys()[id(x)] -
+  /// costKeys()[id(y)]]</tt> instead, where the table has one entry per
+  /// possible displacement. Graphs coarsened from this graph inherit the
+  /// setting.
+  ///
+  /// \warning The metric must be translation invariant.
+  void implicitCosts(const bool implicit) {
+    _implicit_cost = implicit;
+    _cost.clear();
+    if (implicit) {
+      _cost.shrink_to_fit();
+      initCostTable();
+    } else {
+      _cost_key = IntVector();
+      _cost_table = CostVector();
+      _cost.reserve(arcNum());
+      for (int i = 0; i < arcNum(); ++i) {
+        const Arc a = arcFromId(i);
+        const int x = id(source(a)), y = id(target(a)) - _red_num;
+        _cost.emplace_back(_metric(_x_pos[x], _y_pos[y]));
+      }
+    }
+  }
+
+  /// \brief Returns whether the arc costs are implicit
+  bool implicitCosts() const { return _implicit_cost; }
+
+  /// \brief Returns the cost table key of each node, indexed by node id
+  /// \pre \ref implicitCosts() is \c true
+  const IntVector& costKeys() const { return _cost_key; }
+
+  /// \brief Returns the cost of each displacement
+  /// \pre \ref implicitCosts() is \c true
+  const CostVector& costTable() const { return _cost_table; }
+
   // Add all arcs (x,y) with x in rectangle (x_min,x_max) and y in rectangle
   // (y_min,y_max)
   void addArcs(const IntDimArray& x_min, const IntDimArray& x_max,
                const IntDimArray& y_min, const IntDimArray& y_max) {
-    reserveArcs(arcNum() +
-                utils::numNodes(x_min, x_max) * utils::numNodes(y_min, y_max));
+    reserveArcs(arcNum() + utils::numNodes<std::int64_t>(x_min, x_max) *
+                               utils::numNodes<std::int64_t>(y_min, y_max));
 
     IntDimArray x_pos = x_min;
     do {
@@ -253,6 +430,67 @@ class UlmGridGraph : public SmartBpDigraph {
     buildArcs();
   }
 
+  /// \brief Adds the arcs of all boxes, each box like \ref addArcs() and
+  /// the boxes one after another
+  ///
+  /// Unlike one call of \ref addArcs() per box, space is reserved and the
+  /// maps are notified only once, and the boxes are filled in parallel if a
+  /// pool is given. \c B must be derived from \ref ArcBox.
+  ///
+  /// \throws utils::ArcOverflowError if there are more than
+  /// \ref MAX_ARC_NUM arcs in total
+  template <typename B>
+  void addArcBoxes(std::vector<B>& boxes, utils::ThreadPool* pool = nullptr) {
+    ULMON_TRACE_SCOPE("addArcBoxes", "boxes", boxes.size());
+    const int num = boxes.size();
+    std::int64_t m = arcNum();
+    for (const ArcBox& b : boxes) {
+      m += utils::numNodes<std::int64_t>(b.x_min, b.x_max) *
+           utils::numNodes<std::int64_t>(b.y_min, b.y_max);
+    }
+    reserveArcs(m);
+    const int first = Parent::growArcs(m - arcNum());
+    if (!_implicit_cost) _cost.resize(m);
+
+    int next = first;
+    for (ArcBox& b : boxes) {
+      b.first_arc = next;
+      next += utils::numNodes(b.x_min, b.x_max) *
+              utils::numNodes(b.y_min, b.y_max);
+    }
+
+    // Boxes are disjoint ranges of arc ids, so they can be filled in parallel
+    auto fill = [&](const ArcBox& b) {
+      int a = b.first_arc;
+      IntDimArray x_pos = b.x_min;
+      do {
+        const int x = utils::idFromPos(x_pos, _x_strides);
+        IntDimArray y_pos = b.y_min;
+        do {
+          const int y = utils::idFromPos(y_pos, _y_strides);
+          Parent::setArc(a, redNode(x), blueNode(y));
+          if (!_implicit_cost) _cost[a] = _metric(_x_pos[x], _y_pos[y]);
+          ++a;
+          utils::advancePos(b.y_min, b.y_max, y_pos);
+        } while (y_pos != b.y_min);
+        utils::advancePos(b.x_min, b.x_max, x_pos);
+      } while (x_pos != b.x_min);
+    };
+    if (pool && num > 1) {
+      const int chunks = std::min(num, CHUNKS_PER_THREAD * pool->size());
+      pool->run(chunks, [&](const int c) {
+        const int end = std::int64_t(num) * (c + 1) / chunks;
+        for (int k = std::int64_t(num) * c / chunks; k < end; ++k)
+          fill(boxes[k]);
+      });
+    } else {
+      for (const ArcBox& b : boxes) fill(b);
+    }
+
+    Parent::linkArcs(first);
+    buildArcs();
+  }
+
   /// \brief Adds all arcs (x,y) for which _y_min <= y_pos < _y_max and
   /// \c cond(x,y) is true
   void addArcs(std::function<bool(int, int)> cond = [](int, int) {
@@ -271,6 +509,7 @@ class UlmGridGraph : public SmartBpDigraph {
   void clearArcs() {
     Parent::clearArcs();
     _cost.clear();
+    _shield_first.clear();
     _fully = false;
   }
 
@@ -278,22 +517,43 @@ class UlmGridGraph : public SmartBpDigraph {
 
   IntDimArray getPos(const BlueNode y) const { return _y_pos[id(y)]; }
 
+  /// \brief Returns the arc (x,y) if y lies in the shield of x, and
+  /// \c INVALID otherwise
+  ///
+  /// The shield arcs of each red node form a rectangle of consecutive arc
+  /// ids, so the arc is found arithmetically. Only valid until arcs are
+  /// cleared or the shield is updated, and \c INVALID for all arcs if the
+  /// arcs were not added by \ref addAllArcs() or \ref rebuildShield().
+  Arc shieldArc(const RedNode x, const BlueNode y) const {
+    if (_shield_first.empty()) return INVALID;
+    const int i = id(x);
+    const IntDimArray& pos = _y_pos[id(y)];
+    if (!utils::contains(_y_min[i], _y_max[i], pos)) return INVALID;
+    int k = 0;
+    for (int d = 0; d < Dim; ++d) {
+      k = k * (_y_max[i][d] - _y_min[i][d]) + pos[d] - _y_min[i][d];
+    }
+    return arcFromId(_shield_first[i] + k);
+  }
+
   /// \brief Recomputes the shield based on the given support, clears arcs,
   /// reserves space, adds all arcs in the shield, and then adds all missing
   /// arcs from the support
-  void rebuildShield(const SupportVector& support) {
+  ///
+  /// The shield arcs are constructed in parallel if a pool is given.
+  void rebuildShield(const SupportVector& support,
+                     utils::ThreadPool* pool = nullptr) {
+    ULMON_TRACE_SCOPE("rebuildShield");
     // Recompute shield (_y_min, _y_max) and add all these arcs
     resetShield();
     for (const auto& [x, y] : support) updateShield(x, y);
     clearArcs();
-    reserveArcs(utils::numArcs(_y_min, _y_max) + _node_num);
-    addArcs();
+    reserveArcs(utils::numArcs<std::int64_t>(_y_min, _y_max) + _node_num);
+    addShieldArcs(pool);
 
     // Add missing support arcs
     for (const auto& [x, y] : support) {
-      if (!utils::contains(_y_min[id(x)], _y_max[id(x)], _y_pos[id(y)])) {
-        addArcLazily(x, y);
-      }
+      if (shieldArc(x, y) == INVALID) addArcLazily(x, y);
     }
     buildArcs();
   }
@@ -302,63 +562,61 @@ class UlmGridGraph : public SmartBpDigraph {
   /// reserves space, adds all arcs in the shield, and then adds all missing
   /// arcs from the support
   ///
+  /// The shield of each red node covers its support with flow, see
+  /// \ref extendShield(). The shield arcs are constructed in parallel if a
+  /// pool is given.
+  ///
   /// support_arcs[i] = a is the arc corresponding to support[i] = (x,y)
   void rebuildShield(                   //
       const SupportVector& support,     //
       const ValueVector& support_flow,  //
-      ArcVector& support_arcs) {
-    assert(std::is_sorted(support.begin(), support.end()));
+      ArcVector& support_arcs,          //
+      utils::ThreadPool* pool = nullptr) {
+    ULMON_TRACE_SCOPE("rebuildShield", "support", support.size());
     assert(support.size() == support_flow.size());
-    support_arcs.clear();
-    support_arcs.resize(support.size(), arcFromId(-1));
 
     // Recompute shield (_y_min, _y_max) and add all these arcs
     resetShield();
     int i = 0;
     for (const auto& [x, y] : support)
       if (support_flow[i++]) updateShield(x, y);
-    clearArcs();
-    reserveArcs(utils::numArcs(_y_min, _y_max) + _node_num);
-
-    // Add shield arcs
-    auto it = support.begin();
     i = 0;
-    for (int x = 0; x < _red_num; ++x) {
-      if (isIsolated(x)) continue;
-      RedNode xn = redNode(x);
-
-      IntDimArray y_pos = _y_min[x];
-      do {
-        const int y = utils::idFromPos(y_pos, _y_strides);
-        BlueNode yn = blueNode(y);
-        Arc a = addArcLazily(xn, yn);
-
-        auto p = std::make_pair(xn, yn);
-        while (it != support.end() && *it < p) ++it, ++i;
-        if (it != support.end() && *it == p) support_arcs[i] = a;
-
-        utils::advancePos(_y_min[x], _y_max[x], y_pos);
-      } while (y_pos != _y_min[x]);
-    }
+    for (const auto& [x, y] : support)
+      if (support_flow[i++]) extendShield(x, y);
+    clearArcs();
+    reserveArcs(utils::numArcs<std::int64_t>(_y_min, _y_max) + _node_num);
+    addShieldArcs(pool);
 
-    // Add missing support arcs
-    i = 0;
+    // Look up the support arcs arithmetically
+    support_arcs.clear();
+    support_arcs.reserve(support.size());
+    _missing.clear();
     for (const auto& [x, y] : support) {
-      if (!utils::contains(_y_min[id(x)], _y_max[id(x)], _y_pos[id(y)])) {
-        Arc a = addArcLazily(x, y);
-        assert(!valid(support_arcs[i]));
-        support_arcs[i] = a;
+      const Arc a = shieldArc(x, y);
+      if (a == INVALID) {
+        _missing.emplace_back(std::uint64_t(id(x)) * _blue_num + id(y),
+                              support_arcs.size());
       }
-      ++i;
+      support_arcs.push_back(a);
     }
+
+    // Add missing support arcs in sorted order, since the arc order steers
+    // the pivoting on the next level
+    utils::radixSort(_missing, _missing_scratch,
+                     std::uint64_t(_red_num) * _blue_num);
+    for (const auto& [key, i] : _missing)
+      support_arcs[i] = addArcLazily(support[i].first, support[i].second);
     buildArcs();
   }
 
   /// \brief Reserves space for \c m arcs
-  void reserveArcs(int m) {
+  ///
+  /// \throws utils::ArcOverflowError if \c m exceeds \ref MAX_ARC_NUM,
+  /// e.g. for all arcs between two 512x512 grids
+  void reserveArcs(const std::int64_t m) {
     assert(m >= 0);
     Parent::reserveArcs(m);
-    _cost.reserve(m);
+    if (!_implicit_cost) _cost.reserve(m);
   }
 
   /// \brief Resets shield to fully bipartite graph
@@ -369,34 +627,50 @@ class UlmGridGraph : public SmartBpDigraph {
     _y_max.reserve(_red_num);
     for (int x = 0; x < _red_num; ++x) {
       // Zero supply -> empty shield
-      _y_max.emplace_back(_supply[x] == 0 ? IntDimArray{} : _y_dim);
+      _y_max.emplace_back(_x_supply[x] == 0 ? IntDimArray{} : _y_dim);
     }
   }
 
-  void updateShield(const SupportVector& support) {
+  /// \brief Enlarges the shield based on the given support and adds the new
+  /// arcs, in parallel if a pool is given
+  void updateShield(const SupportVector& support,
+                    utils::ThreadPool* pool = nullptr) {
+    ULMON_TRACE_SCOPE("updateShield");
     if (_fully) return;
 
     std::swap(_y_min, _old_y_min);
     std::swap(_y_max, _old_y_max);
     resetShield();
     for (const auto& [x, y] : support) updateShield(x, y);
+    growShield(pool);
+  }
 
-    // _y_min and _y_max hold the best possible shield
-    // Now we determine which arcs we have to add
-    for (int x = 0; x < _red_num; ++x) {
-      for (int i = 0; i < Dim; ++i) {
-        _y_min[x][i] = std::min(_y_min[x][i], _old_y_min[x][i]);
-        _y_max[x][i] = std::max(_y_max[x][i], _old_y_max[x][i]);
-      }
-    }
+  /// \brief Enlarges the shield of each red node such that it contains the
+  /// shield of the given support, see \ref rebuildShield(), and adds the new
+  /// arcs, in parallel if a pool is given
+  ///
+  /// Only the red nodes whose rectangle grows get new arcs, all other arcs
+  /// keep their ids. Since the rectangles never shrink, the graph contains
+  /// the shield of the support afterwards.
+  ///
+  /// \return The number of red nodes whose rectangle grew
+  int updateShield(const SupportVector& support,
+                   const ValueVector& support_flow,
+                   utils::ThreadPool* pool = nullptr) {
+    ULMON_TRACE_SCOPE("updateShield", "support", support.size());
+    assert(support.size() == support_flow.size());
+    if (_fully) return 0;
 
-    // Now all (x,y) with y
-    // (_y_min[x],_y_max[x]) \ (_old_y_min[x],_old_y_max[x]) are missing
-    // The function cond is true iff (x,y) is not in this
-    auto cond = [&](const int& x, const int& y) {
-      return !utils::contains(_old_y_min[x], _old_y_max[x], _y_pos[y]);
-    };
-    addArcs(cond);
+    std::swap(_y_min, _old_y_min);
+    std::swap(_y_max, _old_y_max);
+    resetShield();
+    int i = 0;
+    for (const auto& [x, y] : support)
+      if (support_flow[i++]) updateShield(x, y);
+    i = 0;
+    for (const auto& [x, y] : support)
+      if (support_flow[i++]) extendShield(x, y);
+    return growShield(pool);
   }
 
  protected:
@@ -417,13 +691,131 @@ class UlmGridGraph : public SmartBpDigraph {
         Arc a =
 #endif
             addArcLazily(redNode(x), blueNode(y));
-        assert(id(a) + 1 == _cost.size());
+        assert(_implicit_cost || id(a) + 1 == _cost.size());
       }
 
       utils::advancePos(_y_min[x], _y_max[x], y_pos);
     } while (y_pos != _y_min[x]);
   }
 
+  // Unites the new rectangles with the old ones, adds the arcs that are
+  // not in the old rectangles and returns the number of grown rectangles
+  int growShield(utils::ThreadPool* pool) {
+    int grown = 0;
+    for (int x = 0; x < _red_num; ++x) {
+      if (isIsolated(x)) {
+        // Keep the old rectangle, which may be empty as well
+        _y_min[x] = _old_y_min[x];
+        _y_max[x] = _old_y_max[x];
+        continue;
+      }
+      if (!utils::less(_old_y_min[x], _old_y_max[x])) {
+        ++grown;  // The old rectangle is empty
+        continue;
+      }
+      for (int i = 0; i < Dim; ++i) {
+        _y_min[x][i] = std::min(_y_min[x][i], _old_y_min[x][i]);
+        _y_max[x][i] = std::max(_y_max[x][i], _old_y_max[x][i]);
+      }
+      grown += _y_min[x] != _old_y_min[x] || _y_max[x] != _old_y_max[x];
+    }
+
+    // Now all (x,y) with y
+    // (_y_min[x],_y_max[x]) \ (_old_y_min[x],_old_y_max[x]) are missing
+    addShieldArcs(pool, true);
+    buildArcs();
+
+    // The new arcs of a rectangle are not consecutive to the old ones
+    _shield_first.clear();
+    return grown;
+  }
+
+  // Adds the arcs of all shield rectangles in the order of the red nodes
+  // w/o calling build and records where each rectangle starts. If skip_old
+  // is true, the arcs in the old rectangles are left out. The red nodes are
+  // split into chunks, which count their arcs and then fill them into the
+  // appended storage in parallel if a pool is given.
+  void addShieldArcs(utils::ThreadPool* pool = nullptr,
+                     const bool skip_old = false) {
+    // Number of arcs of red node x
+    auto count = [&](const int x) -> int {
+      if (isIsolated(x)) return 0;
+      int n = utils::numNodes(_y_min[x], _y_max[x]);
+      if (skip_old && utils::less(_old_y_min[x], _old_y_max[x])) {
+        IntDimArray min, max;
+        for (int i = 0; i < Dim; ++i) {
+          min[i] = std::max(_y_min[x][i], _old_y_min[x][i]);
+          max[i] = std::min(_y_max[x][i], _old_y_max[x][i]);
+        }
+        n -= utils::numNodes(min, max);
+      }
+      return n;
+    };
+
+    // Arcs of red node x, starting with id a
+    auto fill = [&](const int x, int a) {
+      if (isIsolated(x)) return;
+      IntDimArray y_pos = _y_min[x];
+      do {
+        if (!skip_old ||
+            !utils::contains(_old_y_min[x], _old_y_max[x], y_pos)) {
+          const int y = utils::idFromPos(y_pos, _y_strides);
+          Parent::setArc(a, redNode(x), blueNode(y));
+          if (!_implicit_cost) _cost[a] = _metric(_x_pos[x], _y_pos[y]);
+          ++a;
+        }
+        utils::advancePos(_y_min[x], _y_max[x], y_pos);
+      } while (y_pos != _y_min[x]);
+    };
+
+    const int chunks =
+        pool ? std::min(_red_num, CHUNKS_PER_THREAD * pool->size()) : 1;
+    auto begin = [&](const int c) {
+      return static_cast<int>(std::int64_t(_red_num) * c / chunks);
+    };
+    auto run = [&](auto body) {
+      if (pool)
+        pool->run(chunks, body);
+      else
+        for (int c = 0; c < chunks; ++c) body(c);
+    };
+
+    // Count the arcs of each chunk, then the chunk offsets
+    _shield_first.resize(_red_num);
+    std::vector<std::int64_t>& offset = _chunk_offset;
+    offset.assign(chunks + 1, 0);
+    run([&](const int c) {
+      for (int x = begin(c); x < begin(c + 1); ++x) {
+        _shield_first[x] = count(x);
+        offset[c + 1] += _shield_first[x];
+      }
+    });
+    for (int c = 0; c < chunks; ++c) offset[c + 1] += offset[c];
+
+    const int first = arcNum();
+    reserveArcs(first + offset[chunks]);
+    Parent::growArcs(offset[chunks]);
+    if (!_implicit_cost) _cost.resize(first + offset[chunks]);
+
+    // Prefix sums and arcs of each chunk
+    run([&](const int c) {
+      int a = first + offset[c];
+      for (int x = begin(c); x < begin(c + 1); ++x) {
+        const int n = _shield_first[x];
+        _shield_first[x] = a;
+        fill(x, a);
+        a += n;
+      }
+    });
+    Parent::linkArcs(first);
+  }
+
+  // Views the marginals stored in _supply
+  inline void viewSupply() {
+    setSupply(ValueView(_supply.data(), _red_num),
+              ValueView(_supply.data() + _red_num, _blue_num));
+  }
+
   inline void initPos() {
     IntDimArray pos{};
     for (int x = 0; x < _red_num; ++x) {
@@ -438,6 +830,42 @@ class UlmGridGraph : public SmartBpDigraph {
     assert(pos == IntDimArray{});
   }
 
+  // The table is indexed by the displacement x_pos - y_pos shifted to be
+  // nonnegative, i.e. by x_pos + y_dim - 1 - y_pos, in a grid with
+  // x_dim + y_dim - 1 points per dimension
+  inline void initCostTable() {
+    IntDimArray table_dim{}, offset{};
+    for (int i = 0; i < Dim; ++i) {
+      table_dim[i] = _x_dim[i] + _y_dim[i] - 1;
+      offset[i] = _y_dim[i] - 1;
+    }
+    const IntDimArray strides = utils::getStrides(table_dim);
+
+    _cost_key.resize(_node_num);
+    for (int x = 0; x < _red_num; ++x) {
+      _cost_key[x] = utils::idFromPos(_x_pos[x], strides) +
+                     utils::idFromPos(offset, strides);
+    }
+    for (int y = 0; y < _blue_num; ++y) {
+      _cost_key[_red_num + y] = utils::idFromPos(_y_pos[y], strides);
+    }
+
+    _cost_table.resize(utils::numNodes(table_dim));
+    IntDimArray pos{}, a{}, b{};
+    for (Cost& c : _cost_table) {
+      for (int i = 0; i < Dim; ++i) {
+        a[i] = std::max(pos[i] - offset[i], 0);
+        b[i] = std::max(offset[i] - pos[i], 0);
+      }
+      c = _metric(a, b);
+      utils::advancePos(table_dim, pos);
+    }
+  }
+
+  inline C implicitCost(const Arc a) const {
+    return _cost_table[_cost_key[id(source(a))] - _cost_key[id(target(a))]];
+  }
+
   // If _y_min[x][i] >= _y_max[x][i] for some i, then x has no nbors
   inline bool isIsolated(const int& x) {
     return !utils::less(_y_min[x], _y_max[x]);
@@ -453,6 +881,20 @@ class UlmGridGraph : public SmartBpDigraph {
     return redNode(x + _x_strides[i]);
   }
 
+  /// \brief Extends the shield of x such that it contains y
+  ///
+  /// If the support is not monotone along the grid axes, the neighbors of x
+  /// may shrink its shield past its own support, even to an empty
+  /// rectangle. The shield then no longer certifies optimality and the
+  /// shielded pivot rule can stop at a suboptimal flow.
+  inline void extendShield(const RedNode& x, const BlueNode& y) {
+    const IntDimArray& pos = _y_pos[id(y)];
+    for (int i = 0; i < Dim; ++i) {
+      _y_min[id(x)][i] = std::min(_y_min[id(x)][i], pos[i]);
+      _y_max[id(x)][i] = std::max(_y_max[id(x)][i], pos[i] + 1);
+    }
+  }
+
   inline void updateShield(const RedNode& x, const BlueNode& y) {
     assert(valid(x));
     assert(valid(y));
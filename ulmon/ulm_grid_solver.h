@@ -4,13 +4,25 @@
 #include <ulmon/core.h>
 #include <ulmon/ulm_network_simplex.h>
 #include <ulmon/utils/grid.h>
+#include <ulmon/utils/metric.h>
+#include <ulmon/utils/radix_sort.h>
+#include <ulmon/utils/statistics.h>
+#include <ulmon/utils/thread_pool.h>
+#include <ulmon/utils/trace.h>
 
 #include <fmt/printf.hpp>
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <numeric>
 #include <optional>
 
 namespace lemon {
 
-template <typename GR>
+/// \tparam GR The grid graph type
+/// \tparam ST The statistics policy of the network simplex on each level,
+/// see \ref statistics()
+template <typename GR, typename ST = utils::NoStatistics>
 class UlmGridSolver {
   using Value = typename GR::Value;
   using Cost = typename GR::Cost;
@@ -18,9 +30,19 @@ class UlmGridSolver {
 
   using IntDimArray = typename GR::IntDimArray;
   using SupportVector = typename GR::SupportVector;
+  using ValueVector = std::vector<Value>;
+  using ValueView = typename GR::ValueView;
+  using CostVector = std::vector<Cost>;
+  using IntVector = std::vector<int>;
+
+  // Coarse support arc and the block of fine arcs added for it by prepare()
+  struct Block : GR::ArcBox {
+    int x, y;  // Coarse red and blue node indices
+    Value flow;
+  };
 
  public:
-  using NetSimplex = UlmNetworkSimplex<GR, Value, Cost>;
+  using NetSimplex = UlmNetworkSimplex<GR, Value, Cost, ST, false>;
   using ProblemType = typename NetSimplex::ProblemType;
 
  private:
@@ -30,15 +52,36 @@ class UlmGridSolver {
   GR& _graph;
   NetSimplex _net;
   SupportVector _support;
+  std::vector<Block> _blocks;
+  ValueVector _warm_flow;  // For the next finer graph, indexed by arc id
+  CostVector _pi_hint;     // For the next finer graph, indexed by node id
 
   // Solver settings
   const int _merge_num;
   const int _max_depth;
   bool _called_run{false};
+  std::unique_ptr<utils::ThreadPool> _pool;
+  bool _incremental_shield{false};
 
- public:
-  // Statistics
-  std::vector<std::vector<double>> _densities;
+  // Statistics of each level
+  std::vector<ST> _statistics;
+
+  // Graph and network simplex of a coarser level. The levels are built by
+  // the constructor and kept across runs, such that a run on another supply
+  // reuses their storage.
+  struct Level {
+    GR graph;
+    NetSimplex net;
+
+    Level(const GR& parent, const int merge_num)
+        : graph(parent, merge_num), net(graph, false) {}
+  };
+  std::vector<std::unique_ptr<Level>> _levels;  // _levels[depth - 1]
+
+  // Scratch data of prolongFlow()
+  IntVector _sup_begin, _dem_begin, _order;
+  ValueVector _sup, _dem, _fine, _coarse;
+  utils::KeyedVector<int> _keyed, _keyed_scratch;
 
  public:
   UlmGridSolver(GR& graph, const int merge_num = 2)
@@ -48,11 +91,38 @@ class UlmGridSolver {
         _max_depth(
             utils::hierarchicalDepth(_graph._x_dim, _graph._y_dim, merge_num)) {
     _support.reserve(countNodes(_graph));
-    _densities.reserve(_max_depth + 1);
+    _statistics.reserve(_max_depth + 1);
+    _levels.reserve(_max_depth);
+    for (int depth = 1; depth <= _max_depth; ++depth) {
+      const GR& parent = depth == 1 ? _graph : _levels.back()->graph;
+      _levels.push_back(std::make_unique<Level>(parent, _merge_num));
+    }
   }
 
+  /// \brief Sets the number of threads used for pricing on all levels
+  UlmGridSolver& threads(const int num_threads) {
+    if (num_threads > 1)
+      _pool = std::make_unique<utils::ThreadPool>(num_threads);
+    else
+      _pool.reset();
+    return *this;
+  }
+
+  /// \brief Updates the shields incrementally on all levels, see
+  /// UlmNetworkSimplex::incrementalShield()
+  UlmGridSolver& incrementalShield(const bool incremental = true) {
+    _incremental_shield = incremental;
+    return *this;
+  }
+
+  /// \brief Solves the problem on the supply of the graph
+  ///
+  /// The coarser levels and all buffers are kept for later runs, so after
+  /// a run on the same supply no further heap memory is allocated.
   ProblemType run() {
+    ULMON_TRACE_SCOPE("run", "depth", 0);
     _called_run = true;
+    _statistics.clear();
 
     if (_max_depth > 0) {
       ProblemType r = run(1, _graph);
@@ -65,12 +135,48 @@ class UlmGridSolver {
     return subsolve(_graph, _net);
   }
 
+  /// \brief Sets the supply of the graph and solves the problem
+  ///
+  /// This reuses the coarser levels, the positions and all buffers of the
+  /// previous runs, so a solver constructed once per grid shape solves many
+  /// problems without setup costs.
+  ///
+  /// \param supply Supply / demand of the nodes as in the constructors of
+  /// the graph, the supplies must sum up to zero
+  ProblemType solve(const ValueVector& supply) {
+    _graph.setSupply(supply);
+    return run();
+  }
+
+  /// \brief Views the marginals of the caller and solves the problem
+  ///
+  /// This is \ref solve() without copying the marginals. The graph keeps
+  /// viewing them, see UlmGridGraph::setSupply().
+  ///
+  /// \param x_supply Supply of the red nodes
+  /// \param y_demand Demand of the blue nodes, i.e. nonnegative values
+  ProblemType solve(const ValueView x_supply, const ValueView y_demand) {
+    _graph.setSupply(x_supply, y_demand);
+    return run();
+  }
+
   ProblemType subsolve(GR& graph, NetSimplex& net) {
+    ULMON_TRACE_SCOPE("subsolve", "nodes", countNodes(graph));
     typename GR::SupplyNodeMap supplyMap(graph);
     typename GR::CostArcMap costMap(graph);
-    net.supplyMap(supplyMap).costMap(costMap);
+    if (graph.implicitCosts()) net.implicitCosts();
+    net.supplyMap(supplyMap).costMap(costMap).threadPool(_pool.get());
+    net.incrementalShield(_incremental_shield);
+    if (_pi_hint.size() == std::size_t(countNodes(graph))) {
+      net.potentialHint(VectorMap<Cost>(_pi_hint));
+      if (_warm_flow.size() == std::size_t(countArcs(graph))) {
+        net.warmStart(VectorMap<Value>(_warm_flow), VectorMap<Cost>(_pi_hint));
+      }
+    }
+    _warm_flow.clear();
+    _pi_hint.clear();
     ProblemType res = net.runShielded();
-    _densities.push_back(net._density);
+    _statistics.push_back(net.statistics());
     return res;
   }
 
@@ -100,7 +206,7 @@ class UlmGridSolver {
           _support.emplace_back(graph.source(a, RedNode{}),
                                 graph.target(a, BlueNode{}));
       }
-      graph.rebuildShield(_support);
+      graph.rebuildShield(_support, _pool.get());
 
       net.reset();
     }
@@ -115,11 +221,34 @@ class UlmGridSolver {
 
   Value flow(Arc a) const { return _net.flow(a); }
 
+  Cost potential(Node n) const { return _net.potential(n); }
+
+  /// \brief Returns the statistics of each level from the coarsest to the
+  /// finest, the refinement time is attributed to the coarser level
+  const std::vector<ST>& statistics() const { return _statistics; }
+
  private:
+  // Node or arc map view of a vector indexed by id
+  template <typename T>
+  class VectorMap {
+    const std::vector<T>& _v;
+
+   public:
+    VectorMap(const std::vector<T>& v) : _v(v) {}
+
+    template <typename Item>
+    T operator[](const Item& i) const {
+      return _v[GR::id(i)];
+    }
+  };
+
   ProblemType run(int depth, GR& parent) {
+    ULMON_TRACE_SCOPE("run", "depth", depth);
     ProblemType r;
 
-    GR graph(parent, _merge_num);
+    GR& graph = _levels[depth - 1]->graph;
+    NetSimplex& net = _levels[depth - 1]->net;
+    graph.coarsen(parent);
 
     if (depth < _max_depth) {
       r = run(depth + 1, graph);
@@ -128,22 +257,29 @@ class UlmGridSolver {
       graph.addAllArcs();
     }
 
-    NetSimplex net(graph, false);
+    net.reset();
     r = subsolve(graph, net);
     if (r != NetSimplex::OPTIMAL) return r;
 
+    typename ST::Scope scope(_statistics.back(), utils::PHASE_REFINEMENT);
     prepare(graph, net, parent);
+    prolongFlow(parent);
+    interpolatePotentials(graph, net, parent);
     return r;
   }
 
   void prepare(const GR& graph, const NetSimplex& net, GR& parent) {
+    ULMON_TRACE_SCOPE("prepare");
     parent.clearArcs();
+    _blocks.clear();
 
     for (ArcIt a(graph); a != INVALID; ++a) {
       if (!net.flow(a)) continue;
 
-      IntDimArray x_min = graph.getPos(graph.source(a, RedNode{}));
-      IntDimArray y_min = graph.getPos(graph.target(a, BlueNode{}));
+      const RedNode x = graph.source(a, RedNode{});
+      const BlueNode y = graph.target(a, BlueNode{});
+      IntDimArray x_min = graph.getPos(x);
+      IntDimArray y_min = graph.getPos(y);
 
       IntDimArray x_max{}, y_max{};
       for (int i = 0; i < Dim; ++i) {
@@ -153,7 +289,163 @@ class UlmGridSolver {
         y_max[i] = std::min(y_min[i] + _merge_num, parent._y_dim[i]);
       }
 
-      parent.addArcs(x_min, x_max, y_min, y_max);
+      _blocks.push_back({{x_min, x_max, y_min, y_max, 0},
+                         graph.id(x),
+                         graph.id(y),
+                         net.flow(a)});
+    }
+    parent.addArcBoxes(_blocks, _pool.get());
+  }
+
+  // Calls f(i, j, v) for the positive amounts v that the north-west corner
+  // rule sends from a[i] to b[j], where a and b have equal sums
+  template <typename F>
+  static void northWestCorner(const Value* a, const int n, const Value* b,
+                              const int m, F f) {
+    if (n == 0 || m == 0) return;
+    int i = 0, j = 0;
+    Value ra = a[0], rb = b[0];
+    while (i < n && j < m) {
+      if (ra == 0) {
+        if (++i < n) ra = a[i];
+      } else if (rb == 0) {
+        if (++j < m) rb = b[j];
+      } else {
+        const Value v = std::min(ra, rb);
+        f(i, j, v);
+        ra -= v;
+        rb -= v;
+      }
+    }
+  }
+
+  // Splits the coarse optimal flow into a feasible flow on the fine arcs
+  // added by prepare(). First, the supply of the fine red nodes of each
+  // coarse red node is split over its blocks, and the demand of the fine
+  // blue nodes likewise, both with the north-west corner rule. Then the
+  // rule distributes these within each block. The positive flows form a
+  // forest, so the flow is a basic solution for warm starting parent.
+  void prolongFlow(const GR& parent) {
+    ULMON_TRACE_SCOPE("prolongFlow");
+    typename GR::SupplyNodeMap supply(parent);
+    const int num = _blocks.size();
+
+    // The split supplies and demands of block k start at sup_begin[k] and
+    // dem_begin[k], indexed in the order of utils::advancePos like the arcs
+    IntVector& sup_begin = _sup_begin;
+    IntVector& dem_begin = _dem_begin;
+    sup_begin.assign(num + 1, 0);
+    dem_begin.assign(num + 1, 0);
+    for (int k = 0; k < num; ++k) {
+      const Block& b = _blocks[k];
+      sup_begin[k + 1] = sup_begin[k] + utils::numNodes(b.x_min, b.x_max);
+      dem_begin[k + 1] = dem_begin[k] + utils::numNodes(b.y_min, b.y_max);
+    }
+    ValueVector& sup = _sup;
+    ValueVector& dem = _dem;
+    sup.assign(sup_begin[num], 0);
+    dem.assign(dem_begin[num], 0);
+
+    // Splits the fine values of the rectangle of blocks[order[k..l)] over
+    // these blocks and stores them at begin[block]
+    ValueVector& fine = _fine;
+    ValueVector& coarse = _coarse;
+    auto split = [&](const IntVector& order, const int k, const int l,
+                     const IntDimArray& min, const IntDimArray& max,
+                     auto value, const IntVector& begin, ValueVector& out) {
+      fine.clear();
+      IntDimArray pos = min;
+      do {
+        fine.push_back(value(pos));
+        utils::advancePos(min, max, pos);
+      } while (pos != min);
+      coarse.clear();
+      for (int i = k; i < l; ++i) coarse.push_back(_blocks[order[i]].flow);
+      northWestCorner(fine.data(), fine.size(), coarse.data(), coarse.size(),
+                      [&](const int i, const int j, const Value v) {
+                        out[begin[order[k + j]] + i] += v;
+                      });
+    };
+
+    // Sorts order stably by the coarse red or blue node of the blocks
+    IntVector& order = _order;
+    auto sortOrder = [&](auto key) {
+      std::uint64_t max_key = 0;
+      _keyed.clear();
+      for (const int k : order) {
+        _keyed.emplace_back(key(_blocks[k]), k);
+        max_key = std::max(max_key, _keyed.back().first);
+      }
+      utils::radixSort(_keyed, _keyed_scratch, max_key);
+      for (int k = 0; k < num; ++k) order[k] = _keyed[k].second;
+    };
+
+    order.resize(num);
+    std::iota(order.begin(), order.end(), 0);
+    sortOrder([](const Block& b) { return b.x; });
+    for (int k = 0, l; k < num; k = l) {
+      const Block& b = _blocks[order[k]];
+      for (l = k + 1; l < num && _blocks[order[l]].x == b.x; ++l) {
+      }
+      split(order, k, l, b.x_min, b.x_max,
+            [&](const IntDimArray& pos) {
+              return supply[parent.redNode(
+                  utils::idFromPos(pos, parent._x_strides))];
+            },
+            sup_begin, sup);
+    }
+
+    sortOrder([](const Block& b) { return b.y; });
+    for (int k = 0, l; k < num; k = l) {
+      const Block& b = _blocks[order[k]];
+      for (l = k + 1; l < num && _blocks[order[l]].y == b.y; ++l) {
+      }
+      split(order, k, l, b.y_min, b.y_max,
+            [&](const IntDimArray& pos) {
+              return -supply[parent.blueNode(
+                  utils::idFromPos(pos, parent._y_strides))];
+            },
+            dem_begin, dem);
+    }
+
+    // Distribute within each block, whose arcs are ordered like the nodes
+    _warm_flow.assign(parent.arcNum(), 0);
+    for (int k = 0; k < num; ++k) {
+      const int n = sup_begin[k + 1] - sup_begin[k];
+      const int m = dem_begin[k + 1] - dem_begin[k];
+      const int first = _blocks[k].first_arc;
+      northWestCorner(&sup[sup_begin[k]], n, &dem[dem_begin[k]], m,
+                      [&](const int i, const int j, const Value v) {
+                        _warm_flow[first + i * m + j] = v;
+                      });
+    }
+  }
+
+  // Interpolates the potentials of net on graph multilinearly to the finer
+  // grid of parent and rescales them, since distances grow by _merge_num
+  void interpolatePotentials(const GR& graph, const NetSimplex& net,
+                             const GR& parent) {
+    ULMON_TRACE_SCOPE("interpolatePotentials");
+    double scale = 1;
+    for (int i = 0; i < MetricDegree<typename GR::Metric>::value; ++i)
+      scale *= _merge_num;
+
+    _pi_hint.resize(countNodes(parent));
+    for (RedNodeIt xx(parent); xx != INVALID; ++xx) {
+      const double pi = utils::coarseInterpolation(
+          _merge_num, graph._x_dim, parent.getPos(xx), [&](const auto& pos) {
+            return net.potential(
+                graph.redNode(utils::idFromPos(pos, graph._x_strides)));
+          });
+      _pi_hint[GR::id(Node(xx))] = std::lround(scale * pi);
+    }
+    for (BlueNodeIt yy(parent); yy != INVALID; ++yy) {
+      const double pi = utils::coarseInterpolation(
+          _merge_num, graph._y_dim, parent.getPos(yy), [&](const auto& pos) {
+            return net.potential(
+                graph.blueNode(utils::idFromPos(pos, graph._y_strides)));
+          });
+      _pi_hint[GR::id(Node(yy))] = std::lround(scale * pi);
     }
   }
 };
@@ -26,15 +26,49 @@
 
 #include <lemon/math.h>
 #include <ulmon/core.h>
+#include <ulmon/utils/pricing.h>
+#include <ulmon/utils/record_field.h>
+#include <ulmon/utils/statistics.h>
+#include <ulmon/utils/trace.h>
 
 #include <algorithm>
 #include <cassert>
+#include <cstdint>
 #include <fmt/printf.hpp>
 #include <limits>
+#include <type_traits>
 #include <vector>
 
 namespace lemon {
 
+/// \brief Whether the node ids of the digraph \c GR are <tt>0, ..., n-1</tt>
+/// and its arc ids are <tt>0, ..., m-1</tt>, i.e. whether \c GR::IdentityIdTag
+/// is \c True
+///
+/// \ref UlmNetworkSimplex then computes its internal indices from the ids
+/// instead of storing them in node and arc maps.
+template <typename GR, typename = void>
+struct IdentityIds : std::false_type {};
+
+template <typename GR>
+struct IdentityIds<GR, std::void_t<typename GR::IdentityIdTag>>
+    : std::integral_constant<bool, GR::IdentityIdTag::value> {};
+
+/// \brief Buffers of the shielded pivot rule of \ref UlmNetworkSimplex, which
+/// only exist if the digraph \c GR has shields
+///
+/// They hold the support of the current flow and are kept by the solver,
+/// such that a repeated run does not allocate them again.
+template <typename GR, typename V, typename = void>
+struct ShieldBuffers {};
+
+template <typename GR, typename V>
+struct ShieldBuffers<GR, V, std::void_t<typename GR::SupportVector>> {
+  typename GR::SupportVector support;
+  typename GR::ArcVector support_arcs;
+  std::vector<V> support_flow;
+};
+
 /// \addtogroup min_cost_flow_algs
 /// @{
 
@@ -65,6 +99,13 @@ namespace lemon {
 /// and supply values in the algorithm. By default, it is \c int.
 /// \tparam C The number type used for costs and potentials in the
 /// algorithm. By default, it is the same as \c V.
+/// \tparam ST The statistics policy, \ref utils::NoStatistics records
+/// nothing and \ref utils::SolverStatistics records pivots, shield changes
+/// and phase times, see \ref statistics().
+/// \tparam CAP Whether the arcs have lower and upper bounds. If it is
+/// \c false, all lower bounds are zero and all capacities are infinite, as in
+/// transportation problems. Then no bounds are stored and \ref lowerMap()
+/// and \ref upperMap() are not available. By default, it is \c true.
 ///
 /// \warning Both \c V and \c C must be signed number types.
 /// \warning All input data (capacities, supply values, and costs) must
@@ -73,7 +114,8 @@ namespace lemon {
 /// \note %UlmNetworkSimplex provides five different pivot rule
 /// implementations, from which the most efficient one is used
 /// by default. For more information, see \ref PivotRule.
-template <typename GR, typename V = int, typename C = V>
+template <typename GR, typename V = int, typename C = V,
+          typename ST = utils::NoStatistics, bool CAP = true>
 class UlmNetworkSimplex {
  public:
   /// The type of the flow amounts, capacity bounds and supply values
@@ -201,10 +243,19 @@ class UlmNetworkSimplex {
   SupplyType _stype;
   Value _sum_supply;
 
+  // Internal indices of the nodes and arcs, stored in maps unless they
+  // follow from the ids, see IdentityIds
+  static constexpr bool IDENTITY_IDS = IdentityIds<GR>::value;
+  struct NoIdMap {
+    explicit NoIdMap(const GR &) {}
+  };
+  typedef std::conditional_t<IDENTITY_IDS, NoIdMap, IntNodeMap> NodeIdMap;
+  typedef std::conditional_t<IDENTITY_IDS, NoIdMap, IntArcMap> ArcIdMap;
+
   // Data structures for storing the digraph
   NodeVector _node;
-  IntNodeMap _node_id;
-  IntArcMap _arc_id;
+  NodeIdMap _node_id;
+  ArcIdMap _arc_id;
   IntVector _source;
   IntVector _target;
   bool _arc_mixing;
@@ -218,15 +269,37 @@ class UlmNetworkSimplex {
   ValueVector _flow;
   CostVector _pi;
 
-  // Data for storing the spanning tree structure
-  IntVector _parent;  // _parent[u] is parent of node u in tree
-  IntVector _pred;  // _pred[u] is arc (u,_parent[u]) or (_parent[u],u) in tree
+  // Data for storing the spanning tree structure. With ULMON_NODE_RECORDS,
+  // the fields that the walks along the cycle read together are interleaved
+  // in one record per node, see resizeTree().
+#ifdef ULMON_NODE_RECORDS
+  struct TreeNode {
+    int parent;
+    int pred;
+    int succ_num;
+    signed char pred_dir;
+  };
+  std::vector<TreeNode> _tree;
+  typedef utils::RecordField<TreeNode, int, &TreeNode::parent> ParentVector;
+  typedef utils::RecordField<TreeNode, int, &TreeNode::pred> PredVector;
+  typedef utils::RecordField<TreeNode, int, &TreeNode::succ_num>
+      SuccNumVector;
+  typedef utils::RecordField<TreeNode, signed char, &TreeNode::pred_dir>
+      PredDirVector;
+#else
+  typedef IntVector ParentVector;
+  typedef IntVector PredVector;
+  typedef IntVector SuccNumVector;
+  typedef CharVector PredDirVector;
+#endif
+  ParentVector _parent;  // _parent[u] is parent of node u in tree
+  PredVector _pred;  // _pred[u] is arc (u,_parent[u]) or (_parent[u],u) in tree
   IntVector _thread;  // _root, _thread[_root], _thread[_thread[_root]], ... is
                       // dfs traversal
   IntVector _rev_thread;  // Same as _thread but reversed
-  IntVector _succ_num;    // Number of successors of node u
-  IntVector _last_succ;   // ?
-  CharVector
+  SuccNumVector _succ_num;  // Number of successors of node u
+  IntVector _last_succ;     // ?
+  PredDirVector
       _pred_dir;  // Determines if _pred[u] is (u,_parent[u]) or (_parent[u],u)
   CharVector _state;      // Tells if arc a is in the tree or not
   IntVector _dirty_revs;  // ?
@@ -236,12 +309,43 @@ class UlmNetworkSimplex {
   int in_arc, join, u_in, v_in, u_out, v_out;
   Value delta;
 
+  // Optional thread pool for pricing
+  utils::ThreadPool *_pool{nullptr};
+
+  // Warm start data, indexed like the internal arcs and nodes
+  ValueVector _warm_flow;
+  CostVector _warm_pi;
+  CharVector _warm_basis;
+  bool _warm_started{false};
+  CostVector _pi_hint;
+
+  // Scratch of initWarmStart() and initialPivots(), kept across runs such
+  // that a repeated run does not allocate
+  struct Scratch {
+    ValueVector flow, excess, pred_flow;
+    IntVector comp, tree_arcs, first, adj, pos, order, parent, pred, stack;
+    CharVector in_tree, pred_dir;
+    std::vector<Node> supply_nodes, demand_nodes, node_stack;
+    IntVector arc_vector;
+  } _scratch;
+
+  // Whether the shielded pivot rule only adds arcs between rebuilds, see
+  // incrementalShield()
+  bool _incremental_shield{false};
+  ShieldBuffers<GR, V> _shield_buffers;
+
+  // Implicit costs of the real arcs, see implicitCosts()
+  bool _implicit_cost{false};
+  IntVector _cost_key;  // Indexed like the internal nodes
+  const Cost *_cost_table{nullptr};
+
+  // Statistics of the current run
+  ST _stats;
+  typedef typename ST::Scope StatsScope;
+
   const Value MAX;
 
  public:
-  // shielded pivot rule statistics
-  std::vector<double> _density;
-
   /// \brief Constant for infinite upper bounds (capacities).
   ///
   /// Constant for infinite upper bounds (capacities).
@@ -254,11 +358,7 @@ class UlmNetworkSimplex {
   class FirstEligiblePivotRule {
    private:
     // References to the UlmNetworkSimplex class
-    const IntVector &_source;
-    const IntVector &_target;
-    const CostVector &_cost;
-    const CharVector &_state;
-    const CostVector &_pi;
+    const UlmNetworkSimplex &_ns;
     int &_in_arc;
     int _search_arc_begin;
     int _arc_end;
@@ -269,11 +369,7 @@ class UlmNetworkSimplex {
    public:
     // Constructor
     FirstEligiblePivotRule(UlmNetworkSimplex &ns)
-        : _source(ns._source),
-          _target(ns._target),
-          _cost(ns._cost),
-          _state(ns._state),
-          _pi(ns._pi),
+        : _ns(ns),
           _in_arc(ns.in_arc),
           _search_arc_begin(ns._search_arc_begin),
           _arc_end(ns._arc_end),
@@ -281,26 +377,15 @@ class UlmNetworkSimplex {
 
     // Find next entering arc
     bool findEnteringArc() {
-      Cost c;
-      // for (int e = _next_arc; e != _search_arc_num; ++e) {
-      for (int e = _next_arc; e != _arc_end; ++e) {
-        c = _state[e] * (_cost[e] + _pi[_source[e]] - _pi[_target[e]]);
-        if (c < 0) {
-          _in_arc = e;
-          _next_arc = e + 1;
-          return true;
-        }
-      }
-      // for (int e = 0; e != _next_arc; ++e) {
-      for (int e = _search_arc_begin; e != _next_arc; ++e) {
-        c = _state[e] * (_cost[e] + _pi[_source[e]] - _pi[_target[e]]);
-        if (c < 0) {
-          _in_arc = e;
-          _next_arc = e + 1;
-          return true;
-        }
+      const utils::PricingArrays<Cost> arrays = _ns.pricingArrays();
+      int e = utils::firstNegative(arrays, _next_arc, _arc_end);
+      if (e == _arc_end) {
+        e = utils::firstNegative(arrays, _search_arc_begin, _next_arc);
+        if (e == _next_arc) return false;
       }
-      return false;
+      _in_arc = e;
+      _next_arc = e + 1;
+      return true;
     }
 
   };  // class FirstEligiblePivotRule
@@ -309,11 +394,7 @@ class UlmNetworkSimplex {
   class BestEligiblePivotRule {
    private:
     // References to the UlmNetworkSimplex class
-    const IntVector &_source;
-    const IntVector &_target;
-    const CostVector &_cost;
-    const CharVector &_state;
-    const CostVector &_pi;
+    const UlmNetworkSimplex &_ns;
     int &_in_arc;
     int _search_arc_begin;
     int _arc_end;
@@ -321,26 +402,16 @@ class UlmNetworkSimplex {
    public:
     // Constructor
     BestEligiblePivotRule(UlmNetworkSimplex &ns)
-        : _source(ns._source),
-          _target(ns._target),
-          _cost(ns._cost),
-          _state(ns._state),
-          _pi(ns._pi),
+        : _ns(ns),
           _in_arc(ns.in_arc),
           _search_arc_begin(ns._search_arc_begin),
           _arc_end(ns._arc_end) {}
 
     // Find next entering arc
     bool findEnteringArc() {
-      Cost c, min = 0;
-      // for (int e = 0; e != _search_arc_num; ++e) {
-      for (int e = _search_arc_begin; e != _arc_end; ++e) {
-        c = _state[e] * (_cost[e] + _pi[_source[e]] - _pi[_target[e]]);
-        if (c < min) {
-          min = c;
-          _in_arc = e;
-        }
-      }
+      const utils::PricingArrays<Cost> arrays = _ns.pricingArrays();
+      Cost min = 0;
+      utils::minReducedCost(arrays, _search_arc_begin, _arc_end, min, _in_arc);
       return min < 0;
     }
 
@@ -350,14 +421,11 @@ class UlmNetworkSimplex {
   class BlockSearchPivotRule {
    private:
     // References to the UlmNetworkSimplex class
-    const IntVector &_source;
-    const IntVector &_target;
-    const CostVector &_cost;
-    const CharVector &_state;
-    const CostVector &_pi;
+    const UlmNetworkSimplex &_ns;
     int &_in_arc;
     int _search_arc_begin;
     int _arc_end;
+    utils::ThreadPool *_pool;
 
     // Pivot rule data
     int _block_size;
@@ -366,14 +434,11 @@ class UlmNetworkSimplex {
    public:
     // Constructor
     BlockSearchPivotRule(UlmNetworkSimplex &ns)
-        : _source(ns._source),
-          _target(ns._target),
-          _cost(ns._cost),
-          _state(ns._state),
-          _pi(ns._pi),
+        : _ns(ns),
           _in_arc(ns.in_arc),
           _search_arc_begin(ns._search_arc_begin),
           _arc_end(ns._arc_end),
+          _pool(ns._pool),
           _next_arc(_search_arc_begin) {
       // The main parameters of the pivot rule
       const double BLOCK_SIZE_FACTOR = 1.0;
@@ -387,38 +452,13 @@ class UlmNetworkSimplex {
 
     // Find next entering arc
     bool findEnteringArc() {
-      Cost c, min = 0;
-      int cnt = _block_size;
-      int e;
-      // for (e = _next_arc; e != _search_arc_num; ++e) {
-      for (e = _next_arc; e != _arc_end; ++e) {
-        c = _state[e] * (_cost[e] + _pi[_source[e]] - _pi[_target[e]]);
-        if (c < min) {
-          min = c;
-          _in_arc = e;
-        }
-        if (--cnt == 0) {
-          if (min < 0) goto search_end;
-          cnt = _block_size;
-        }
-      }
-      // for (e = 0; e != _next_arc; ++e) {
-      for (e = _search_arc_begin; e != _next_arc; ++e) {
-        c = _state[e] * (_cost[e] + _pi[_source[e]] - _pi[_target[e]]);
-        if (c < min) {
-          min = c;
-          _in_arc = e;
-        }
-        if (--cnt == 0) {
-          if (min < 0) goto search_end;
-          cnt = _block_size;
-        }
+      const utils::PricingArrays<Cost> arrays = _ns.pricingArrays();
+      if (_pool) {
+        return utils::blockSearch(arrays, _search_arc_begin, _next_arc,
+                                  _arc_end, _block_size, _in_arc, *_pool);
       }
-      if (min >= 0) return false;
-
-    search_end:
-      _next_arc = e;
-      return true;
+      return utils::blockSearch(arrays, _search_arc_begin, _next_arc, _arc_end,
+                                _block_size, _in_arc);
     }
 
   };  // class BlockSearchPivotRule
@@ -427,11 +467,7 @@ class UlmNetworkSimplex {
   class CandidateListPivotRule {
    private:
     // References to the UlmNetworkSimplex class
-    const IntVector &_source;
-    const IntVector &_target;
-    const CostVector &_cost;
-    const CharVector &_state;
-    const CostVector &_pi;
+    const UlmNetworkSimplex &_ns;
     int &_in_arc;
     int _search_arc_begin;
     int _arc_end;
@@ -445,11 +481,7 @@ class UlmNetworkSimplex {
    public:
     /// Constructor
     CandidateListPivotRule(UlmNetworkSimplex &ns)
-        : _source(ns._source),
-          _target(ns._target),
-          _cost(ns._cost),
-          _state(ns._state),
-          _pi(ns._pi),
+        : _ns(ns),
           _in_arc(ns.in_arc),
           _search_arc_begin(ns._search_arc_begin),
           _arc_end(ns._arc_end),
@@ -472,6 +504,7 @@ class UlmNetworkSimplex {
 
     /// Find next entering arc
     bool findEnteringArc() {
+      const utils::PricingArrays<Cost> arrays = _ns.pricingArrays();
       Cost min, c;
       int e;
       if (_curr_length > 0 && _minor_count < _minor_limit) {
@@ -481,7 +514,7 @@ class UlmNetworkSimplex {
         min = 0;
         for (int i = 0; i < _curr_length; ++i) {
           e = _candidates[i];
-          c = _state[e] * (_cost[e] + _pi[_source[e]] - _pi[_target[e]]);
+          c = arrays.reducedCost(e);
           if (c < min) {
             min = c;
             _in_arc = e;
@@ -497,7 +530,7 @@ class UlmNetworkSimplex {
       _curr_length = 0;
       // for (e = _next_arc; e != _search_arc_num; ++e) {
       for (e = _next_arc; e != _arc_end; ++e) {
-        c = _state[e] * (_cost[e] + _pi[_source[e]] - _pi[_target[e]]);
+        c = arrays.reducedCost(e);
         if (c < 0) {
           _candidates[_curr_length++] = e;
           if (c < min) {
@@ -509,7 +542,7 @@ class UlmNetworkSimplex {
       }
       // for (e = 0; e != _next_arc; ++e) {
       for (e = _search_arc_begin; e != _next_arc; ++e) {
-        c = _state[e] * (_cost[e] + _pi[_source[e]] - _pi[_target[e]]);
+        c = arrays.reducedCost(e);
         if (c < 0) {
           _candidates[_curr_length++] = e;
           if (c < min) {
@@ -533,11 +566,7 @@ class UlmNetworkSimplex {
   class AlteringListPivotRule {
    private:
     // References to the UlmNetworkSimplex class
-    const IntVector &_source;
-    const IntVector &_target;
-    const CostVector &_cost;
-    const CharVector &_state;
-    const CostVector &_pi;
+    const UlmNetworkSimplex &_ns;
     int &_in_arc;
     int _search_arc_begin;
     int _arc_end;
@@ -568,11 +597,7 @@ class UlmNetworkSimplex {
    public:
     // Constructor
     AlteringListPivotRule(UlmNetworkSimplex &ns)
-        : _source(ns._source),
-          _target(ns._target),
-          _cost(ns._cost),
-          _state(ns._state),
-          _pi(ns._pi),
+        : _ns(ns),
           _in_arc(ns.in_arc),
           _search_arc_begin(ns._search_arc_begin),
           _arc_end(ns._arc_end),
@@ -597,12 +622,13 @@ class UlmNetworkSimplex {
 
     // Find next entering arc
     bool findEnteringArc() {
+      const utils::PricingArrays<Cost> arrays = _ns.pricingArrays();
       // Check the current candidate list
       int e;
       Cost c;
       for (int i = 0; i != _curr_length; ++i) {
         e = _candidates[i];
-        c = _state[e] * (_cost[e] + _pi[_source[e]] - _pi[_target[e]]);
+        c = arrays.reducedCost(e);
         if (c < 0) {
           _cand_cost[e - _search_arc_begin] = c;
         } else {
@@ -616,7 +642,7 @@ class UlmNetworkSimplex {
 
       // for (e = _next_arc; e != _search_arc_num; ++e) {
       for (e = _next_arc; e != _arc_end; ++e) {
-        c = _state[e] * (_cost[e] + _pi[_source[e]] - _pi[_target[e]]);
+        c = arrays.reducedCost(e);
         if (c < 0) {
           _cand_cost[e - _search_arc_begin] = c;
           _candidates[_curr_length++] = e;
@@ -629,7 +655,7 @@ class UlmNetworkSimplex {
       }
       // for (e = 0; e != _next_arc; ++e) {
       for (e = _search_arc_begin; e != _next_arc; ++e) {
-        c = _state[e] * (_cost[e] + _pi[_source[e]] - _pi[_target[e]]);
+        c = arrays.reducedCost(e);
         if (c < 0) {
           _cand_cost[e - _search_arc_begin] = c;
           _candidates[_curr_length++] = e;
@@ -665,8 +691,12 @@ class UlmNetworkSimplex {
     // The main parameters of the pivot rule
     constexpr static double BLOCK_SIZE_FACTOR = 1.0;
     constexpr static int MIN_BLOCK_SIZE = 10;
+    // An incrementally updated shield is rebuilt once it has this many times
+    // the arcs of the last rebuild
+    constexpr static double SHIELD_GROWTH_LIMIT = 1.5;
 
     // References to the UlmNetworkSimplex class
+    const UlmNetworkSimplex &_ns;
     const GR &_graph;
 
     const int _node_num;
@@ -678,8 +708,7 @@ class UlmNetworkSimplex {
 
     // Data structures for storing the digraph
     const NodeVector &_node;
-    const IntNodeMap &_node_id;
-    IntArcMap &_arc_id;
+    ArcIdMap &_arc_id;
     IntVector &_source;
     IntVector &_target;
     const bool _arc_mixing;
@@ -693,14 +722,15 @@ class UlmNetworkSimplex {
     const CostVector &_pi;
 
     // Data for storing the spanning tree structure
-    const IntVector &_parent;
-    IntVector &_pred;
+    const ParentVector &_parent;
+    PredVector &_pred;
     const IntVector &_thread;
-    const CharVector &_pred_dir;
+    const PredDirVector &_pred_dir;
     CharVector &_state;
     const int _root;
 
     int &_in_arc;
+    utils::ThreadPool *_pool;
 
     const Value INF;
 
@@ -711,14 +741,14 @@ class UlmNetworkSimplex {
     int _call_num = 0;
     int _phase = 0;
     int _counter = 0;
+    int _rebuild_arc_num = 0;
 
-    typename GR::SupportVector _support;
-    typename GR::ArcVector _support_arcs;
-    ValueVector _support_flow;
-    IntVector _perm, _inv_perm;
+    typename GR::SupportVector &_support;
+    typename GR::ArcVector &_support_arcs;
+    ValueVector &_support_flow;
 
-    // statistics
-    std::vector<double> &_density;
+    // Statistics
+    ST &_stats;
 
     // Search function ptr
     bool (ShieldedPivotRule::*_search)();
@@ -726,7 +756,8 @@ class UlmNetworkSimplex {
    public:
     // Constructor
     ShieldedPivotRule(UlmNetworkSimplex &ns)
-        : _graph(ns._graph),
+        : _ns(ns),
+          _graph(ns._graph),
           _node_num(ns._node_num),
           _arc_num(ns._arc_num),
           _all_arc_begin(ns._all_arc_begin),
@@ -734,7 +765,6 @@ class UlmNetworkSimplex {
           _arc_begin(ns._arc_begin),
           _arc_end(ns._arc_end),
           _node(ns._node),
-          _node_id(ns._node_id),
           _arc_id(ns._arc_id),
           _source(ns._source),
           _target(ns._target),
@@ -752,10 +782,14 @@ class UlmNetworkSimplex {
           _state(ns._state),
           _root(ns._root),
           _in_arc(ns.in_arc),
+          _pool(ns._pool),
           INF(ns.INF),
           _next_arc(_search_arc_begin),
           _search_begin(_search_arc_begin),
-          _density(ns._density),
+          _support(ns._shield_buffers.support),
+          _support_arcs(ns._shield_buffers.support_arcs),
+          _support_flow(ns._shield_buffers.support_flow),
+          _stats(ns._stats),
           _search(&ShieldedPivotRule::firstEligible) {
       _block_size =
           std::max(int(BLOCK_SIZE_FACTOR *
@@ -765,8 +799,6 @@ class UlmNetworkSimplex {
       _support.reserve(_node_num);
       _support_arcs.reserve(_node_num);
       _support_flow.reserve(_node_num);
-      _perm.reserve(_node_num);
-      _inv_perm.reserve(_node_num);
 
       assert(!ns._has_lower);  // Not supported
       assert(!ns._has_upper);  // Not supported
@@ -788,10 +820,31 @@ class UlmNetworkSimplex {
 #ifndef NDEBUG
       int c = totalCost();
 #endif
-      prepareRebuild();
-      const_cast<GR &>(_graph).rebuildShield(  //
-          _support, _support_flow, _support_arcs);
-      rebuildInternals();
+      {
+        StatsScope scope(_stats, utils::PHASE_SHIELD);
+        prepareRebuild();
+        if (_ns._incremental_shield && _rebuild_arc_num > 0 &&
+            _arc_num < SHIELD_GROWTH_LIMIT * _rebuild_arc_num) {
+          // Only the red nodes whose shield grew get new arcs, the tree and
+          // all other arcs stay as they are
+          ArcIt oldBegin(_graph);
+          const_cast<GR &>(_graph).updateShield(_support, _support_flow,
+                                                _pool);
+          // The graph contains the shield of the support and no arc is
+          // eligible, hence the flow is optimal
+          if (oldBegin == ArcIt{_graph}) return false;
+
+          // Start the search with the new arcs
+          _next_arc = _arc_end;
+          updateInternals(oldBegin);
+          _search_begin = _search_arc_begin;
+          return (this->*_search)();
+        }
+        const_cast<GR &>(_graph).rebuildShield(  //
+            _support, _support_flow, _support_arcs, _pool);
+        rebuildInternals();
+        _rebuild_arc_num = _arc_num;
+      }
       assert(c == totalCost());
 
       // Set search related parameters
@@ -801,218 +854,147 @@ class UlmNetworkSimplex {
       return (this->*_search)();
     }
 
-    // Find next entering arc
-    bool _findEnteringArc() {
-      if (blockSearch()) return true;
-
-      if (_search_begin != _search_arc_begin) {
-        _next_arc = _search_arc_begin;
-        _search_begin = _search_arc_begin;
-        if (blockSearch()) return true;
-      }
-
-      prepareUpdate();
-      ArcIt oldBegin(_graph);
-      const_cast<GR &>(_graph).updateShield(_support);
-      if (oldBegin == ArcIt{_graph}) return false;
-
-      _next_arc = _arc_end;
-      _search_begin = _arc_end;
-      updateInternals(oldBegin);
-      return blockSearch();
+   private:
+    // Number of arcs from a to b, both inclusive, when cycling through
+    // [begin, end)
+    static inline int cyclicLength(const int begin, const int end,
+                                   const int a, const int b) {
+      return b >= a ? b - a + 1 : (end - a) + (b - begin) + 1;
     }
 
-   private:
     // Classic first eligible search (only until _arc_end)
     inline bool firstEligible() {
-      Cost c;
-      // for (int e = _next_arc; e != _search_arc_num; ++e) {
-      for (int e = _next_arc; e != _arc_end; ++e) {
-        c = _state[e] * (_cost[e] + _pi[_source[e]] - _pi[_target[e]]);
-        if (c < 0) {
-          _in_arc = e;
-          _next_arc = e + 1;
-          return true;
-        }
-      }
-      // if (feasibleSol()) return false;  // Trigger rebuild
-      // for (int e = 0; e != _next_arc; ++e) {
-      for (int e = _search_arc_begin; e != _next_arc; ++e) {
-        c = _state[e] * (_cost[e] + _pi[_source[e]] - _pi[_target[e]]);
-        if (c < 0) {
-          _in_arc = e;
-          _next_arc = e + 1;
-          return true;
+      const utils::PricingArrays<Cost> arrays = _ns.pricingArrays();
+      int e = utils::firstNegative(arrays, _next_arc, _arc_end);
+      if (e == _arc_end) {
+        // if (feasibleSol()) return false;  // Trigger rebuild
+        e = utils::firstNegative(arrays, _search_arc_begin, _next_arc);
+        if (e == _next_arc) {
+          _stats.search(_arc_end - _search_arc_begin);
+          return false;
         }
       }
-      return false;
+      _stats.search(cyclicLength(_search_arc_begin, _arc_end, _next_arc, e));
+      _in_arc = e;
+      _next_arc = e + 1;
+      return true;
     }
 
     // Classic block search as in the block search pivot rule
     inline bool blockSearch() {
-      Cost c, min = 0;
-      int cnt = _block_size;
-      int e;
-      // for (e = _next_arc; e != _search_arc_num; ++e) {
-      for (e = _next_arc; e != _arc_end; ++e) {
-        c = _state[e] * (_cost[e] + _pi[_source[e]] - _pi[_target[e]]);
-        if (c < min) {
-          min = c;
-          _in_arc = e;
-        }
-        if (--cnt == 0) {
-          if (min < 0) goto search_end;
-          cnt = _block_size;
-        }
-      }
-      // for (e = 0; e != _next_arc; ++e) {
-      for (e = _search_begin; e != _next_arc; ++e) {
-        c = _state[e] * (_cost[e] + _pi[_source[e]] - _pi[_target[e]]);
-        if (c < min) {
-          min = c;
-          _in_arc = e;
-        }
-        if (--cnt == 0) {
-          if (min < 0) goto search_end;
-          cnt = _block_size;
-        }
-      }
-      if (min >= 0) return false;
-
-    search_end:
-      _next_arc = e;
-      return true;
-    }
-
-    inline void prepareUpdate() {
-      using RedNode = typename GR::RedNode;
-      using BlueNode = typename GR::BlueNode;
-
-      _support.clear();
-      for (int u = _thread[_root]; u != _root; u = _thread[u]) {
-        // _parent[u] == _root if and only if _pred[u] is an artificial arc
-        if (_parent[u] == _root || _flow[_pred[u]] == 0) continue;
-        assert(_state[_pred[u]] == STATE_TREE);
-
-        RedNode x;
-        BlueNode y;
-        if (_pred_dir[u] == DIR_UP) {
-          assert(_graph.red(_node[u]));
-          assert(_graph.blue(_node[_parent[u]]));
-          x = _graph.asRedNodeUnsafe(_node[u]);
-          y = _graph.asBlueNodeUnsafe(_node[_parent[u]]);
-        } else {  // _pred_dir[u] == DIR_DOWN
-          assert(_graph.red(_node[_parent[u]]));
-          assert(_graph.blue(_node[u]));
-          x = _graph.asRedNodeUnsafe(_node[_parent[u]]);
-          y = _graph.asBlueNodeUnsafe(_node[u]);
-        }
-
-        _support.emplace_back(x, y);
-      }
-      assert(_support.size() < static_cast<std::size_t>(_node_num));
+      const utils::PricingArrays<Cost> arrays = _ns.pricingArrays();
+      const int next = _next_arc;
+      const bool found =
+          _pool ? utils::blockSearch(arrays, _search_begin, _next_arc,
+                                     _arc_end, _block_size, _in_arc, *_pool)
+                : utils::blockSearch(arrays, _search_begin, _next_arc,
+                                     _arc_end, _block_size, _in_arc);
+      // The search ends with the block of the entering arc, or at the start
+      _stats.search(found && _next_arc != next
+                        ? cyclicLength(_search_begin, _arc_end, next,
+                                       _next_arc)
+                        : _arc_end - _search_begin);
+      return found;
     }
 
     inline void prepareRebuild() {
-      using RedNode = typename GR::RedNode;
-      using BlueNode = typename GR::BlueNode;
+      ULMON_TRACE_SCOPE("prepareRebuild");
 
-      // Gather support from tree
+      // The spanning tree maintains the support in _pred, indexed by the
+      // nodes, so it is read in node order instead of following _thread.
+      // The graph looks up the arcs arithmetically, so the support need not
+      // be sorted.
       _support.clear();
-      for (int u = _thread[_root]; u != _root; u = _thread[u]) {
+      _support_flow.clear();
+      for (int u = 0; u != _node_num; ++u) {
         // _parent[u] == _root if and only if _pred[u] is an artificial arc
         if (_parent[u] == _root) continue;
-        assert(_state[_pred[u]] == STATE_TREE);
-
-        RedNode x;
-        BlueNode y;
-        if (_pred_dir[u] == DIR_UP) {
-          assert(_graph.red(_node[u]));
-          assert(_graph.blue(_node[_parent[u]]));
-          x = _graph.asRedNodeUnsafe(_node[u]);
-          y = _graph.asBlueNodeUnsafe(_node[_parent[u]]);
-        } else {  // _pred_dir[u] == DIR_DOWN
-          assert(_graph.red(_node[_parent[u]]));
-          assert(_graph.blue(_node[u]));
-          x = _graph.asRedNodeUnsafe(_node[_parent[u]]);
-          y = _graph.asBlueNodeUnsafe(_node[u]);
-        }
-
-        _support.emplace_back(x, y);
+        const int e = _pred[u];
+        assert(_state[e] == STATE_TREE);
+        assert(_graph.red(_node[_source[e]]));
+        assert(_graph.blue(_node[_target[e]]));
+
+        _support.emplace_back(_graph.asRedNodeUnsafe(_node[_source[e]]),
+                              _graph.asBlueNodeUnsafe(_node[_target[e]]));
+        _support_flow.push_back(_flow[e]);
       }
       assert(_support.size() < static_cast<std::size_t>(_node_num));
-
-      // Sort _support, keep sorting permutation
-      _perm.resize(_support.size());
-      for (std::size_t i = 0; i < _perm.size(); ++i) _perm[i] = i;
-      std::sort(_perm.begin(), _perm.end(), [&](const int &i, const int &j) {
-        return _support[i] < _support[j];
-      });
-      std::sort(_support.begin(), _support.end());
-
-      // Inverse sorting
-      _inv_perm.resize(_perm.size());
-      for (std::size_t i = 0; i < _inv_perm.size(); ++i)
-        _inv_perm[_perm[i]] = i;
-
-      // Store support flow in the sorted order
-      _support_flow.resize(_support.size());
-      for (int u = _thread[_root], i = 0; u != _root; u = _thread[u]) {
-        // _parent[u] == _root if and only if _pred[u] is an artificial arc
-        if (_parent[u] == _root) continue;
-
-        _support_flow[_inv_perm[i]] = _flow[_pred[u]];
-        ++i;
-      }
     }
 
     inline void updateInternals(ArcIt old_begin) {
+      ULMON_TRACE_SCOPE("updateInternals");
       int delta = countArcs(_graph) - _arc_num;
       assert(delta > 0);
       _arc_num += delta;
       int i = _arc_end;
       _arc_end += delta;
+      _stats.shieldUpdate(delta, static_cast<double>(_arc_num) /
+                                     _graph.redNum() / _graph.blueNum());
 
       // Resize
       _source.resize(_arc_end);
       _target.resize(_arc_end);
-      _lower.resize(_arc_end, 0);
-      _upper.resize(_arc_end, INF);
-      _cap.resize(_arc_end, INF);
-      _cost.resize(_arc_end);
+      if constexpr (CAP) {
+        _lower.resize(_arc_end, 0);
+        _upper.resize(_arc_end, INF);
+        _cap.resize(_arc_end, INF);
+      }
+      if (!_ns._implicit_cost) _cost.resize(_arc_end);
       _flow.resize(_arc_end, 0);
       _state.resize(_arc_end, STATE_LOWER);
 
       // Copy new arcs
+      if constexpr (IDENTITY_IDS) {
+        copyArcs(_arc_num - delta, _arc_num);
+      } else {
+        typename GR::CostArcMap cost_map(_graph);
+        for (ArcIt a(_graph); a != old_begin; ++a, ++i) {
+          _arc_id[a] = i;
+          _source[i] = _ns.nodeIndex(_graph.source(a));
+          _target[i] = _ns.nodeIndex(_graph.target(a));
+          if (!_ns._implicit_cost) _cost[i] = cost_map[a];
+        }
+        assert(i == _arc_end);
+      }
+
+      _block_size =
+          std::max(int(BLOCK_SIZE_FACTOR *
+                       std::sqrt(double(_arc_end - _search_arc_begin))),
+                   MIN_BLOCK_SIZE);
+    }
+
+    // Copies the arcs with ids in [first, last) to their internal indices,
+    // only used with identity ids
+    inline void copyArcs(const int first, const int last) {
       typename GR::CostArcMap cost_map(_graph);
-      for (ArcIt a(_graph); a != old_begin; ++a, ++i) {
-        _arc_id[a] = i;
-        _source[i] = _node_id[_graph.source(a)];
-        _target[i] = _node_id[_graph.target(a)];
-        _cost[i] = cost_map[a];
+      for (int k = first, i = _arc_begin + first; k != last; ++k, ++i) {
+        const Arc a = _graph.arcFromId(k);
+        _source[i] = _graph.id(_graph.source(a));
+        _target[i] = _graph.id(_graph.target(a));
+        if (!_ns._implicit_cost) _cost[i] = cost_map[a];
       }
-      assert(i == _arc_end);
     }
 
     inline void rebuildInternals() {
+      ULMON_TRACE_SCOPE("rebuildInternals", "arcs", countArcs(_graph));
       assert(_support.size() == _support_flow.size());
       assert(_support.size() == _support_arcs.size());
-      assert(_support.size() == _perm.size());
-      assert(_support.size() == _inv_perm.size());
 
       // New _arc_num and _arc_end
       _arc_num = countArcs(_graph);
       _arc_end = _arc_begin + _arc_num;
-      _density.push_back(static_cast<double>(_arc_num) /
-                         (_graph.redNum() * _graph.blueNum()));
+      _stats.shieldRebuild(_arc_num, static_cast<double>(_arc_num) /
+                                         _graph.redNum() / _graph.blueNum());
 
       // Resize
       _source.resize(_arc_end);
       _target.resize(_arc_end);
-      _lower.resize(_arc_end, 0);
-      _upper.resize(_arc_end, INF);
-      _cap.resize(_arc_end, INF);
-      _cost.resize(_arc_end);
+      if constexpr (CAP) {
+        _lower.resize(_arc_end, 0);
+        _upper.resize(_arc_end, INF);
+        _cap.resize(_arc_end, INF);
+      }
+      if (!_ns._implicit_cost) _cost.resize(_arc_end);
 
       _flow.resize(_arc_begin);
       _flow.resize(_arc_end, 0);
@@ -1021,16 +1003,18 @@ class UlmNetworkSimplex {
 
       // Copy arcs
       typename GR::CostArcMap cost_map(_graph);
-      if (_arc_mixing && _node_num > 1) {
+      if constexpr (IDENTITY_IDS) {
+        copyArcs(0, _arc_num);
+      } else if (_arc_mixing && _node_num > 1) {
         // Store the arcs in a mixed order
         const int skip = std::max(_arc_num / _node_num, 3);
         // int i = 0, j = 0;
         int i = _arc_begin, j = 0;
         for (ArcIt a(_graph); a != INVALID; ++a) {
           _arc_id[a] = i;
-          _source[i] = _node_id[_graph.source(a)];
-          _target[i] = _node_id[_graph.target(a)];
-          _cost[i] = cost_map[a];
+          _source[i] = _ns.nodeIndex(_graph.source(a));
+          _target[i] = _ns.nodeIndex(_graph.target(a));
+          if (!_ns._implicit_cost) _cost[i] = cost_map[a];
           // if ((i += skip) >= _arc_num) i = ++j;
           if ((i += skip) >= _arc_end) i = ++j + _arc_begin;
         }
@@ -1038,21 +1022,20 @@ class UlmNetworkSimplex {
         int i = _arc_begin;
         for (ArcIt a(_graph); a != INVALID; ++a, ++i) {
           _arc_id[a] = i;
-          _source[i] = _node_id[_graph.source(a)];
-          _target[i] = _node_id[_graph.target(a)];
-          _cost[i] = cost_map[a];
+          _source[i] = _ns.nodeIndex(_graph.source(a));
+          _target[i] = _ns.nodeIndex(_graph.target(a));
+          if (!_ns._implicit_cost) _cost[i] = cost_map[a];
         }
       }
 
-      // Set _pred, _flow and _state
-      for (int u = _thread[_root], i = 0; u != _root; u = _thread[u]) {
+      // Set _pred, _flow and _state in the order of prepareRebuild()
+      for (int u = 0, i = 0; u != _node_num; ++u) {
         if (_parent[u] == _root) continue;
 
-        int j = _inv_perm[i];  // Index of original i-th element
-        assert(_graph.valid(_support_arcs[j]));
-        int e = _arc_id[_support_arcs[j]];
+        assert(_graph.valid(_support_arcs[i]));
+        int e = _ns.arcIndex(_support_arcs[i]);
         _pred[u] = e;
-        _flow[e] = _support_flow[j];
+        _flow[e] = _support_flow[i];
         _state[e] = STATE_TREE;
         ++i;
       }
@@ -1066,8 +1049,8 @@ class UlmNetworkSimplex {
     int totalCost() {
       int c = 0;
       for (ArcIt a(_graph); a != INVALID; ++a) {
-        int i = _arc_id[a];
-        c += _flow[i] * _cost[i];
+        int i = _ns.arcIndex(a);
+        c += _flow[i] * _ns.arcCost(i);
       }
       return c;
     }
@@ -1091,6 +1074,8 @@ class UlmNetworkSimplex {
   /// In general, it leads to similar performance as using the original
   /// arc order, but it makes the algorithm more robust and in special
   /// cases, even significantly faster. Therefore, it is enabled by default.
+  /// It has no effect if the digraph has identity ids (see \ref IdentityIds),
+  /// then the arcs are stored in the order of their ids.
   UlmNetworkSimplex(const GR &graph, bool arc_mixing = true)
       : _graph(graph),
         _node_id(graph),
@@ -1129,9 +1114,10 @@ class UlmNetworkSimplex {
   /// \return <tt>(*this)</tt>
   template <typename LowerMap>
   UlmNetworkSimplex &lowerMap(const LowerMap &map) {
+    static_assert(CAP, "Lower bounds require CAP");
     _has_lower = true;
     for (ArcIt a(_graph); a != INVALID; ++a) {
-      _lower[_arc_id[a]] = map[a];
+      _lower[arcIndex(a)] = map[a];
     }
     return *this;
   }
@@ -1150,9 +1136,10 @@ class UlmNetworkSimplex {
   /// \return <tt>(*this)</tt>
   template <typename UpperMap>
   UlmNetworkSimplex &upperMap(const UpperMap &map) {
+    static_assert(CAP, "Upper bounds require CAP");
     _has_upper = true;
     for (ArcIt a(_graph); a != INVALID; ++a) {
-      _upper[_arc_id[a]] = map[a];
+      _upper[arcIndex(a)] = map[a];
     }
     return *this;
   }
@@ -1170,8 +1157,9 @@ class UlmNetworkSimplex {
   /// \return <tt>(*this)</tt>
   template <typename CostMap>
   UlmNetworkSimplex &costMap(const CostMap &map) {
+    if (_implicit_cost) return *this;
     for (ArcIt a(_graph); a != INVALID; ++a) {
-      _cost[_arc_id[a]] = map[a];
+      _cost[arcIndex(a)] = map[a];
     }
     return *this;
   }
@@ -1192,7 +1180,7 @@ class UlmNetworkSimplex {
   template <typename SupplyMap>
   UlmNetworkSimplex &supplyMap(const SupplyMap &map) {
     for (NodeIt n(_graph); n != INVALID; ++n) {
-      _supply[_node_id[n]] = map[n];
+      _supply[nodeIndex(n)] = map[n];
     }
     return *this;
   }
@@ -1218,8 +1206,8 @@ class UlmNetworkSimplex {
     for (int i = 0; i != _node_num; ++i) {
       _supply[i] = 0;
     }
-    _supply[_node_id[s]] = k;
-    _supply[_node_id[t]] = -k;
+    _supply[nodeIndex(s)] = k;
+    _supply[nodeIndex(t)] = -k;
     return *this;
   }
 
@@ -1237,6 +1225,170 @@ class UlmNetworkSimplex {
     return *this;
   }
 
+  /// \brief Set the thread pool used for pricing.
+  ///
+  /// This function sets a thread pool that the \ref BLOCK_SEARCH and
+  /// \ref SHIELDED pivot rules use to search several blocks of arcs in
+  /// parallel. The entering arcs, and hence the solution, are the same as
+  /// without a pool. The pool is not owned and must outlive the runs of the
+  /// algorithm. By default, or if \c nullptr is given, pricing is sequential.
+  ///
+  /// \return <tt>(*this)</tt>
+  UlmNetworkSimplex &threadPool(utils::ThreadPool *pool) {
+    _pool = pool;
+    return *this;
+  }
+
+  /// \brief Update the shield incrementally in the \ref SHIELDED pivot rule.
+  ///
+  /// This function makes the \ref SHIELDED pivot rule enlarge the shield
+  /// when no arc is eligible instead of rebuilding it from scratch. Only the
+  /// red nodes whose shield rectangle grew get new arcs, and the spanning
+  /// tree and all other arcs keep their indices. Since the shield never
+  /// shrinks then, it is rebuilt once the number of arcs has grown by half
+  /// since the last rebuild. By default, the shield is always rebuilt.
+  ///
+  /// \return <tt>(*this)</tt>
+  UlmNetworkSimplex &incrementalShield(const bool incremental = true) {
+    _incremental_shield = incremental;
+    return *this;
+  }
+
+  /// \brief Set a flow to start the algorithm from.
+  ///
+  /// This function sets a flow from which the next runs start instead of
+  /// the artificial spanning tree. The arcs with flow strictly between
+  /// their bounds must form a forest, which is completed to a spanning
+  /// tree by artificial arcs. The node potentials are computed from this
+  /// tree. If the flow does not meet the supplies, the artificial arcs
+  /// carry the differences and are driven out as usual.
+  ///
+  /// Warm starts are only used if the supplies sum up to zero. If a flow
+  /// value violates its bounds, or the arcs strictly between their bounds
+  /// contain a cycle, the algorithm starts from the artificial spanning tree.
+  ///
+  /// \param flow An arc map storing the flow values.
+  ///
+  /// \return <tt>(*this)</tt>
+  ///
+  /// \pre \ref reset() must be called before this function if the digraph
+  /// was modified.
+  template <typename FlowMap>
+  UlmNetworkSimplex &warmStart(const FlowMap &flow) {
+    _warm_flow.assign(_arc_end, 0);
+    for (ArcIt a(_graph); a != INVALID; ++a) {
+      _warm_flow[arcIndex(a)] = flow[a];
+    }
+    _warm_pi.clear();
+    _warm_basis.clear();
+    return *this;
+  }
+
+  /// \brief Set a flow and potentials to start the algorithm from.
+  ///
+  /// Same as \ref warmStart(const FlowMap &), but the arcs at their bounds
+  /// that have zero reduced cost with respect to the given potentials are
+  /// added to the forest as well. Each tree component whose supplies are
+  /// met by the flow gets the given potential of its first node. A
+  /// component with a deficit is attached to the root by an artificial arc
+  /// of the usual big cost instead, which carries the deficit, so its
+  /// potentials are shifted away from the given ones. For an optimal flow
+  /// and optimal potentials, the algorithm terminates without a pivot.
+  ///
+  /// \param flow An arc map storing the flow values.
+  /// \param potential A node map storing the potentials.
+  ///
+  /// \return <tt>(*this)</tt>
+  template <typename FlowMap, typename PotentialMap>
+  UlmNetworkSimplex &warmStart(const FlowMap &flow,
+                               const PotentialMap &potential) {
+    warmStart(flow);
+    _warm_pi.resize(_node_num);
+    for (NodeIt n(_graph); n != INVALID; ++n) {
+      _warm_pi[nodeIndex(n)] = potential[n];
+    }
+    return *this;
+  }
+
+  /// \brief Set a basis to start the algorithm from.
+  ///
+  /// This function sets the arcs of a spanning tree or forest from which
+  /// the next runs start. The forest is completed to a spanning tree by
+  /// artificial arcs, all other arcs are at their lower bounds, and the
+  /// flow and the potentials are computed from the tree. A basis stored
+  /// by \ref basisMap() can be used to re-solve a modified problem.
+  ///
+  /// Warm starts are only used if the supplies sum up to zero. If the
+  /// given arcs contain a cycle or a tree arc would violate its bounds,
+  /// the algorithm starts from the artificial spanning tree.
+  ///
+  /// \param basis A \c bool arc map that is \c true on the tree arcs.
+  ///
+  /// \return <tt>(*this)</tt>
+  ///
+  /// \pre \ref reset() must be called before this function if the digraph
+  /// was modified.
+  template <typename BasisMap>
+  UlmNetworkSimplex &warmStartBasis(const BasisMap &basis) {
+    _warm_basis.assign(_arc_end, false);
+    for (ArcIt a(_graph); a != INVALID; ++a) {
+      _warm_basis[arcIndex(a)] = basis[a];
+    }
+    _warm_flow.clear();
+    _warm_pi.clear();
+    return *this;
+  }
+
+  /// \brief Set estimates of the optimal potentials.
+  ///
+  /// This function sets estimates of the optimal node potentials, e.g.
+  /// interpolated from the solution of a coarser problem. The initial
+  /// potentials of the artificial spanning tree are then the hinted ones,
+  /// shifted by the artificial cost on the demand nodes, so that pricing
+  /// prefers arcs with small reduced cost with respect to the hint.
+  /// The hint is only used if the supplies sum up to zero, and it does not
+  /// affect the optimality of the solution.
+  ///
+  /// \param map A node map storing the estimated potentials.
+  ///
+  /// \return <tt>(*this)</tt>
+  template <typename PotentialMap>
+  UlmNetworkSimplex &potentialHint(const PotentialMap &map) {
+    _pi_hint.resize(_node_num);
+    for (NodeIt n(_graph); n != INVALID; ++n) {
+      _pi_hint[nodeIndex(n)] = map[n];
+    }
+    return *this;
+  }
+
+  /// \brief Look up the arc costs in the cost table of the graph.
+  ///
+  /// This function makes pricing compute the cost of each arc from the
+  /// displacement of its end nodes with the cost table of the graph (see
+  /// UlmGridGraph::implicitCosts()) instead of reading it from an arc
+  /// array, which saves memory and bandwidth in the hottest loop. While it
+  /// is enabled, \ref costMap() has no effect. Disabling it sets all costs
+  /// to \c 1 again.
+  ///
+  /// \pre The underlying graph has implicit costs.
+  ///
+  /// \return <tt>(*this)</tt>
+  UlmNetworkSimplex &implicitCosts(const bool implicit = true) {
+    const bool was_implicit = _implicit_cost;
+    _implicit_cost = implicit;
+    if (implicit) {
+      _cost_table = _graph.costTable().data();
+      initCostKeys();
+      _cost.resize(_arc_begin);
+      if (!was_implicit) _cost.shrink_to_fit();
+    } else {
+      _cost_table = nullptr;
+      _cost_key = IntVector();
+      _cost.resize(_arc_end, 1);
+    }
+    return *this;
+  }
+
   /// @}
 
   /// \name Execution Control
@@ -1278,15 +1430,17 @@ class UlmNetworkSimplex {
   /// \see ProblemType, PivotRule
   /// \see resetParams(), reset()
   ProblemType run(PivotRule pivot_rule = BLOCK_SEARCH) {
-    if (!init()) return INFEASIBLE;
-    return start(pivot_rule);
+    startStatistics();
+    const ProblemType r = init() ? start(pivot_rule) : INFEASIBLE;
+    _stats.stop();
+    return r;
   }
 
   ProblemType runShielded() {
-    _density.push_back(static_cast<double>(_arc_num) /
-                       (_graph.redNum() * _graph.blueNum()));
-    if (!init()) return INFEASIBLE;
-    return start<ShieldedPivotRule>();
+    startStatistics();
+    const ProblemType r = init() ? start<ShieldedPivotRule>() : INFEASIBLE;
+    _stats.stop();
+    return r;
   }
 
   /// \brief Reset all the parameters that have been given before.
@@ -1329,11 +1483,17 @@ class UlmNetworkSimplex {
     for (int i = 0; i != _node_num; ++i) {
       _supply[i] = 0;
     }
+    _warm_flow.clear();
+    _warm_pi.clear();
+    _warm_basis.clear();
+    _pi_hint.clear();
     // for (int i = 0; i != _arc_num; ++i) {
     for (int i = _arc_begin; i != _arc_end; ++i) {
-      _lower[i] = 0;
-      _upper[i] = INF;
-      _cost[i] = 1;
+      if constexpr (CAP) {
+        _lower[i] = 0;
+        _upper[i] = INF;
+      }
+      if (!_implicit_cost) _cost[i] = 1;
     }
     _has_lower = false;
     _has_upper = false;
@@ -1371,14 +1531,17 @@ class UlmNetworkSimplex {
     _arc_end = _arc_num + 2 * _node_num;
 
     // Reserve vectors
-    int res_arc_num = ULMON_CONST_RESERVE * max_arc_num;
+    const std::int64_t res_arc_num =
+        ULMON_CONST_RESERVE * static_cast<std::int64_t>(max_arc_num);
     _source.reserve(res_arc_num);
     _target.reserve(res_arc_num);
 
-    _lower.reserve(res_arc_num);
-    _upper.reserve(res_arc_num);
-    _cap.reserve(res_arc_num);
-    _cost.reserve(res_arc_num);
+    if constexpr (CAP) {
+      _lower.reserve(res_arc_num);
+      _upper.reserve(res_arc_num);
+      _cap.reserve(res_arc_num);
+    }
+    if (!_implicit_cost) _cost.reserve(res_arc_num);
 
     _flow.reserve(res_arc_num);
 
@@ -1389,52 +1552,65 @@ class UlmNetworkSimplex {
     _source.resize(max_arc_num);
     _target.resize(max_arc_num);
 
-    _lower.resize(max_arc_num);
-    _upper.resize(max_arc_num);
-    _cap.resize(max_arc_num);
-    _cost.resize(max_arc_num);
+    if constexpr (CAP) {
+      _lower.resize(max_arc_num);
+      _upper.resize(max_arc_num);
+      _cap.resize(max_arc_num);
+    }
+    _cost.resize(_implicit_cost ? _arc_begin : max_arc_num);
     _supply.resize(all_node_num);
     _flow.resize(max_arc_num);
     _pi.resize(all_node_num);
 
-    _parent.resize(all_node_num);
-    _pred.resize(all_node_num);
-    _pred_dir.resize(all_node_num);
-    _thread.resize(all_node_num);
-    _rev_thread.resize(all_node_num);
-    _succ_num.resize(all_node_num);
-    _last_succ.resize(all_node_num);
+    resizeTree(all_node_num);
     _state.resize(max_arc_num);
 
     // Copy the graph
-    int i = 0;
-    for (NodeIt n(_graph); n != INVALID; ++n, ++i) {
-      _node_id[n] = i;
-      _node[i] = n;
-    }
-    _node[_node_num] = INVALID;
-    if (_arc_mixing && _node_num > 1) {
-      // Store the arcs in a mixed order
-      const int skip = std::max(_arc_num / _node_num, 3);
-      // int i = 0, j = 0;
-      int i = _arc_begin, j = 0;
+    if constexpr (IDENTITY_IDS) {
+      // The internal indices follow from the ids, the arcs are stored in the
+      // order of their ids such that added arcs are appended
+      for (NodeIt n(_graph); n != INVALID; ++n) {
+        assert(_graph.id(n) < _node_num);
+        _node[_graph.id(n)] = n;
+      }
       for (ArcIt a(_graph); a != INVALID; ++a) {
-        _arc_id[a] = i;
-        _source[i] = _node_id[_graph.source(a)];
-        _target[i] = _node_id[_graph.target(a)];
-        // if ((i += skip) >= _arc_num) i = ++j;
-        if ((i += skip) >= _arc_end) i = ++j + _arc_begin;
+        const int i = arcIndex(a);
+        assert(i < _arc_end);
+        _source[i] = _graph.id(_graph.source(a));
+        _target[i] = _graph.id(_graph.target(a));
       }
+      _node[_node_num] = INVALID;
     } else {
-      // Store the arcs in the original order
-      // int i = 0;
-      int i = _arc_begin;
-      for (ArcIt a(_graph); a != INVALID; ++a, ++i) {
-        _arc_id[a] = i;
-        _source[i] = _node_id[_graph.source(a)];
-        _target[i] = _node_id[_graph.target(a)];
+      int i = 0;
+      for (NodeIt n(_graph); n != INVALID; ++n, ++i) {
+        _node_id[n] = i;
+        _node[i] = n;
+      }
+      _node[_node_num] = INVALID;
+      if (_arc_mixing && _node_num > 1) {
+        // Store the arcs in a mixed order
+        const int skip = std::max(_arc_num / _node_num, 3);
+        // int i = 0, j = 0;
+        int i = _arc_begin, j = 0;
+        for (ArcIt a(_graph); a != INVALID; ++a) {
+          _arc_id[a] = i;
+          _source[i] = nodeIndex(_graph.source(a));
+          _target[i] = nodeIndex(_graph.target(a));
+          // if ((i += skip) >= _arc_num) i = ++j;
+          if ((i += skip) >= _arc_end) i = ++j + _arc_begin;
+        }
+      } else {
+        // Store the arcs in the original order
+        // int i = 0;
+        int i = _arc_begin;
+        for (ArcIt a(_graph); a != INVALID; ++a, ++i) {
+          _arc_id[a] = i;
+          _source[i] = nodeIndex(_graph.source(a));
+          _target[i] = nodeIndex(_graph.target(a));
+        }
       }
     }
+    if (_implicit_cost) initCostKeys();
 
     // Reset parameters
     resetParams();
@@ -1469,8 +1645,8 @@ class UlmNetworkSimplex {
   Number totalCost() const {
     Number c = 0;
     for (ArcIt a(_graph); a != INVALID; ++a) {
-      int i = _arc_id[a];
-      c += Number(_flow[i]) * Number(_cost[i]);
+      int i = arcIndex(a);
+      c += Number(_flow[i]) * Number(arcCost(i));
     }
     return c;
   }
@@ -1484,7 +1660,7 @@ class UlmNetworkSimplex {
   /// This function returns the flow on the given arc.
   ///
   /// \pre \ref run() must be called before using this function.
-  Value flow(const Arc &a) const { return _flow[_arc_id[a]]; }
+  Value flow(const Arc &a) const { return _flow[arcIndex(a)]; }
 
   /// \brief Copy the flow values (the primal solution) into the
   /// given map.
@@ -1497,7 +1673,7 @@ class UlmNetworkSimplex {
   template <typename FlowMap>
   void flowMap(FlowMap &map) const {
     for (ArcIt a(_graph); a != INVALID; ++a) {
-      map.set(a, _flow[_arc_id[a]]);
+      map.set(a, _flow[arcIndex(a)]);
     }
   }
 
@@ -1507,7 +1683,7 @@ class UlmNetworkSimplex {
   /// given node.
   ///
   /// \pre \ref run() must be called before using this function.
-  Cost potential(const Node &n) const { return _pi[_node_id[n]]; }
+  Cost potential(const Node &n) const { return _pi[nodeIndex(n)]; }
 
   /// \brief Copy the potential values (the dual solution) into the
   /// given map.
@@ -1521,7 +1697,38 @@ class UlmNetworkSimplex {
   template <typename PotentialMap>
   void potentialMap(PotentialMap &map) const {
     for (NodeIt n(_graph); n != INVALID; ++n) {
-      map.set(n, _pi[_node_id[n]]);
+      map.set(n, _pi[nodeIndex(n)]);
+    }
+  }
+
+  /// \brief Return the statistics of the last run.
+  ///
+  /// The search length and the shield changes are only recorded by the
+  /// shielded pivot rule, see \ref runShielded().
+  ///
+  /// \pre \ref run() must be called before using this function.
+  const ST &statistics() const { return _stats; }
+
+  /// \brief Return whether the last run started from the warm start.
+  ///
+  /// It is \c false if no warm start was given or if it was rejected, e.g.
+  /// because its flow violates the bounds, and the run started from the
+  /// artificial spanning tree instead.
+  ///
+  /// \pre \ref run() must be called before using this function.
+  bool warmStarted() const { return _warm_started; }
+
+  /// \brief Copy the final spanning tree into the given map.
+  ///
+  /// This function sets the given \c bool arc map to \c true on the arcs
+  /// of the final spanning tree and to \c false on all other arcs.
+  /// It can be passed to \ref warmStartBasis().
+  ///
+  /// \pre \ref run() must be called before using this function.
+  template <typename BasisMap>
+  void basisMap(BasisMap &map) const {
+    for (ArcIt a(_graph); a != INVALID; ++a) {
+      map.set(a, _state[arcIndex(a)] == STATE_TREE);
     }
   }
 
@@ -1546,7 +1753,9 @@ class UlmNetworkSimplex {
                 "Upper bounds must be greater or equal to the lower bounds");
 
     // Remove non-zero lower bounds
-    if (_has_lower) {
+    if constexpr (!CAP) {
+      // All capacities are infinite
+    } else if (_has_lower) {
       // for (int i = 0; i != _arc_num; ++i) {
       for (int i = _arc_begin; i != _arc_end; ++i) {
         Value c = _lower[i];
@@ -1573,7 +1782,7 @@ class UlmNetworkSimplex {
       ART_COST = 0;
       // for (int i = 0; i != _arc_num; ++i) {
       for (int i = _arc_begin; i != _arc_end; ++i) {
-        if (_cost[i] > ART_COST) ART_COST = _cost[i];
+        if (arcCost(i) > ART_COST) ART_COST = arcCost(i);
       }
       ART_COST = (ART_COST + 1) * _node_num;
     }
@@ -1611,22 +1820,25 @@ class UlmNetworkSimplex {
         _rev_thread[u + 1] = u;
         _succ_num[u] = 1;
         _last_succ[u] = u;
-        _cap[e] = INF;
+        setInfiniteCap(e);
         _state[e] = STATE_TREE;
+        // The artificial arcs are never priced, hence their costs may be
+        // shifted such that the potentials are the hinted ones
+        const Cost hint = _pi_hint.empty() ? 0 : _pi_hint[u];
         if (_supply[u] >= 0) {
           _pred_dir[u] = DIR_UP;
-          _pi[u] = 0;
+          _pi[u] = hint;
           _source[e] = u;
           _target[e] = _root;
           _flow[e] = _supply[u];
-          _cost[e] = 0;
+          _cost[e] = -hint;
         } else {
           _pred_dir[u] = DIR_DOWN;
-          _pi[u] = ART_COST;
+          _pi[u] = ART_COST + hint;
           _source[e] = _root;
           _target[e] = u;
           _flow[e] = -_supply[u];
-          _cost[e] = ART_COST;
+          _cost[e] = ART_COST + hint;
         }
       }
     } else if (_sum_supply > 0) {
@@ -1648,7 +1860,7 @@ class UlmNetworkSimplex {
           _pred[u] = e;
           _source[e] = u;
           _target[e] = _root;
-          _cap[e] = INF;
+          setInfiniteCap(e);
           _flow[e] = _supply[u];
           _cost[e] = 0;
           _state[e] = STATE_TREE;
@@ -1658,13 +1870,13 @@ class UlmNetworkSimplex {
           _pred[u] = f;
           _source[f] = _root;
           _target[f] = u;
-          _cap[f] = INF;
+          setInfiniteCap(f);
           _flow[f] = -_supply[u];
           _cost[f] = ART_COST;
           _state[f] = STATE_TREE;
           _source[e] = u;
           _target[e] = _root;
-          _cap[e] = INF;
+          setInfiniteCap(e);
           _flow[e] = 0;
           _cost[e] = 0;
           _state[e] = STATE_LOWER;
@@ -1692,7 +1904,7 @@ class UlmNetworkSimplex {
           _pred[u] = e;
           _source[e] = _root;
           _target[e] = u;
-          _cap[e] = INF;
+          setInfiniteCap(e);
           _flow[e] = -_supply[u];
           _cost[e] = 0;
           _state[e] = STATE_TREE;
@@ -1702,13 +1914,13 @@ class UlmNetworkSimplex {
           _pred[u] = f;
           _source[f] = u;
           _target[f] = _root;
-          _cap[f] = INF;
+          setInfiniteCap(f);
           _flow[f] = _supply[u];
           _state[f] = STATE_TREE;
           _cost[f] = ART_COST;
           _source[e] = _root;
           _target[e] = u;
-          _cap[e] = INF;
+          setInfiniteCap(e);
           _flow[e] = 0;
           _cost[e] = 0;
           _state[e] = STATE_LOWER;
@@ -1719,12 +1931,234 @@ class UlmNetworkSimplex {
       _all_arc_begin = f + 1;
     }
 
+    // Replace the artificial spanning tree by the warm start, if any
+    _warm_started = initWarmStart(ART_COST);
+    _stats.warmStart(_warm_started);
+
     return true;
   }
 
+  // Build the spanning tree from the warm start data. Returns false and
+  // keeps the artificial spanning tree if there is no usable warm start.
+  bool initWarmStart(const Cost ART_COST) {
+    const bool has_basis = !_warm_basis.empty();
+    const bool has_flow = !_warm_flow.empty();
+    if (!(has_basis || has_flow) || _sum_supply != 0) return false;
+    if (int(has_basis ? _warm_basis.size() : _warm_flow.size()) != _arc_end)
+      return false;  // The digraph changed
+
+    // Flow on the real arcs with respect to the shifted bounds
+    ValueVector &flow = _scratch.flow;
+    flow.assign(_arc_end, 0);
+    if (has_flow) {
+      for (int i = _arc_begin; i != _arc_end; ++i) {
+        flow[i] = _warm_flow[i] - (_has_lower ? lowerBound(i) : 0);
+        if (flow[i] < 0 || flow[i] > capacity(i)) return false;
+      }
+    }
+
+    // Spanning forest of the basic arcs using union-find
+    IntVector &comp = _scratch.comp, &tree_arcs = _scratch.tree_arcs;
+    CharVector &in_tree = _scratch.in_tree;
+    comp.resize(_node_num);
+    tree_arcs.clear();
+    in_tree.assign(_arc_end, false);
+    for (int u = 0; u != _node_num; ++u) comp[u] = u;
+    auto find = [&](int u) {
+      while (comp[u] != u) u = comp[u] = comp[comp[u]];
+      return u;
+    };
+    auto join = [&](const int i) {
+      const int u = find(_source[i]), v = find(_target[i]);
+      if (u == v) return false;
+      comp[u] = v;
+      in_tree[i] = true;
+      tree_arcs.push_back(i);
+      return true;
+    };
+    for (int i = _arc_begin; i != _arc_end; ++i) {
+      const bool basic =
+          has_basis ? _warm_basis[i] : flow[i] > 0 && flow[i] < capacity(i);
+      if (basic && !join(i)) return false;
+    }
+    if (!_warm_pi.empty()) {
+      for (int i = _arc_begin; i != _arc_end; ++i) {
+        if (!in_tree[i] &&
+            arcCost(i) + _warm_pi[_source[i]] - _warm_pi[_target[i]] == 0)
+          join(i);
+      }
+    }
+
+    // Adjacency lists of the forest
+    IntVector &first = _scratch.first, &adj = _scratch.adj;
+    first.assign(_node_num + 1, 0);
+    adj.resize(2 * tree_arcs.size());
+    for (const int i : tree_arcs) {
+      ++first[_source[i] + 1];
+      ++first[_target[i] + 1];
+    }
+    for (int u = 0; u != _node_num; ++u) first[u + 1] += first[u];
+    {
+      IntVector &pos = _scratch.pos;
+      pos.assign(first.begin(), first.end() - 1);
+      for (const int i : tree_arcs) {
+        adj[pos[_source[i]]++] = i;
+        adj[pos[_target[i]]++] = i;
+      }
+    }
+
+    // Depth first search from the first node of each component, which is
+    // attached to the root by its artificial arc
+    IntVector &order = _scratch.order, &parent = _scratch.parent,
+              &pred = _scratch.pred, &stack = _scratch.stack;
+    CharVector &pred_dir = _scratch.pred_dir;
+    order.clear();
+    order.reserve(_node_num);
+    parent.assign(_node_num, -1);
+    pred.resize(_node_num);
+    stack.clear();
+    pred_dir.resize(_node_num);
+    for (int r = 0; r != _node_num; ++r) {
+      if (parent[r] != -1) continue;
+      parent[r] = _root;
+      pred[r] = _arc_begin - 1 - r;
+      stack.push_back(r);
+      while (!stack.empty()) {
+        const int u = stack.back();
+        stack.pop_back();
+        order.push_back(u);
+        for (int k = first[u]; k != first[u + 1]; ++k) {
+          const int i = adj[k];
+          if (i == pred[u]) continue;
+          const int v = _source[i] == u ? _target[i] : _source[i];
+          parent[v] = u;
+          pred[v] = i;
+          pred_dir[v] = v == _source[i] ? DIR_UP : DIR_DOWN;
+          stack.push_back(v);
+        }
+      }
+    }
+
+    // Flow on the tree arcs from the excesses of the subtrees
+    ValueVector &excess = _scratch.excess, &pred_flow = _scratch.pred_flow;
+    excess.assign(_supply.begin(), _supply.begin() + _node_num);
+    pred_flow.resize(_node_num);
+    for (int i = _arc_begin; i != _arc_end; ++i) {
+      if (in_tree[i] || flow[i] == 0) continue;
+      excess[_source[i]] -= flow[i];
+      excess[_target[i]] += flow[i];
+    }
+    for (int k = _node_num - 1; k >= 0; --k) {
+      const int u = order[k];
+      if (parent[u] == _root) {
+        // Artificial arc, its direction depends on the excess
+        pred_dir[u] = excess[u] < 0 ? DIR_DOWN : DIR_UP;
+        pred_flow[u] = pred_dir[u] * excess[u];
+        continue;
+      }
+      pred_flow[u] = pred_dir[u] * excess[u];
+      if (pred_flow[u] < 0 || pred_flow[u] > capacity(pred[u])) return false;
+      excess[parent[u]] += excess[u];
+    }
+
+    // The warm start is valid, replace the artificial spanning tree
+    for (int i = _arc_begin; i != _arc_end; ++i) {
+      _flow[i] = flow[i];
+      _state[i] = flow[i] == 0 ? STATE_LOWER : STATE_UPPER;
+    }
+    for (int u = 0, e = _arc_begin - 1; u != _node_num; ++u, --e) {
+      _flow[e] = 0;
+      _state[e] = STATE_LOWER;
+    }
+    for (int u = 0; u != _node_num; ++u) {
+      const int e = pred[u];
+      _parent[u] = parent[u];
+      _pred[u] = e;
+      _pred_dir[u] = pred_dir[u];
+      _flow[e] = pred_flow[u];
+      _state[e] = STATE_TREE;
+      if (parent[u] != _root) continue;
+      if (pred_dir[u] == DIR_UP) {
+        _source[e] = u;
+        _target[e] = _root;
+        _cost[e] = _warm_pi.empty() ? 0 : -_warm_pi[u];
+      } else {
+        // Only arcs from the root may carry flow into the components, hence
+        // they keep the big cost that drives the flow out of the root
+        _source[e] = _root;
+        _target[e] = u;
+        _cost[e] = ART_COST;
+      }
+    }
+
+    // Thread, successor numbers and last successors from the dfs order
+    _thread[_root] = order[0];
+    _rev_thread[order[0]] = _root;
+    for (int k = 0; k != _node_num; ++k) {
+      const int u = order[k], next = k + 1 != _node_num ? order[k + 1] : _root;
+      _thread[u] = next;
+      _rev_thread[next] = u;
+      _succ_num[u] = 1;
+    }
+    _last_succ[_root] = order[_node_num - 1];
+    for (int k = _node_num - 1; k >= 0; --k) {
+      const int u = order[k];
+      _last_succ[u] = order[k + _succ_num[u] - 1];
+      if (parent[u] != _root) _succ_num[parent[u]] += _succ_num[u];
+    }
+
+    // Potentials along the thread
+    for (int k = 0; k != _node_num; ++k) {
+      const int u = order[k], e = _pred[u];
+      _pi[u] = _pi[_parent[u]] - _pred_dir[u] * arcCost(e);
+    }
+
+    return true;
+  }
+
+  // Resizes the spanning tree arrays to n nodes
+  void resizeTree(const int n) {
+#ifdef ULMON_NODE_RECORDS
+    _tree.resize(n);
+    _parent = ParentVector(_tree);
+    _pred = PredVector(_tree);
+    _succ_num = SuccNumVector(_tree);
+    _pred_dir = PredDirVector(_tree);
+#else
+    _parent.resize(n);
+    _pred.resize(n);
+    _succ_num.resize(n);
+    _pred_dir.resize(n);
+#endif
+    _thread.resize(n);
+    _rev_thread.resize(n);
+    _last_succ.resize(n);
+  }
+
+  // Capacity of the arc e, infinite without CAP
+  inline Value capacity(const int e) const {
+    if constexpr (CAP)
+      return _cap[e];
+    else
+      return INF;
+  }
+
+  // Lower bound of the arc e, zero without CAP
+  inline Value lowerBound(const int e) const {
+    if constexpr (CAP)
+      return _lower[e];
+    else
+      return 0;
+  }
+
+  inline void setInfiniteCap(const int e) {
+    if constexpr (CAP) _cap[e] = INF;
+  }
+
   // Check if the upper bound is greater than or equal to the lower bound
   // on each arc.
   bool checkBoundMaps() {
+    if constexpr (!CAP) return true;
     // for (int j = 0; j != _arc_num; ++j) {
     for (int j = _arc_begin; j != _arc_end; ++j) {
       if (_upper[j] < _lower[j]) return false;
@@ -1759,7 +2193,7 @@ class UlmNetworkSimplex {
       first = _target[in_arc];
       second = _source[in_arc];
     }
-    delta = _cap[in_arc];
+    delta = capacity(in_arc);
     int result = 0;
     Value c, d;
     int e;
@@ -1769,7 +2203,7 @@ class UlmNetworkSimplex {
       e = _pred[u];
       d = _flow[e];
       if (_pred_dir[u] == DIR_DOWN) {
-        c = _cap[e];
+        c = capacity(e);
         d = c >= MAX ? INF : c - d;
       }
       if (d < delta) {
@@ -1784,7 +2218,7 @@ class UlmNetworkSimplex {
       e = _pred[u];
       d = _flow[e];
       if (_pred_dir[u] == DIR_UP) {
-        c = _cap[e];
+        c = capacity(e);
         d = c >= MAX ? INF : c - d;
       }
       if (d <= delta) {
@@ -1952,9 +2386,55 @@ class UlmNetworkSimplex {
     }
   }
 
+  // Internal index of the node n
+  inline int nodeIndex(const Node &n) const {
+    if constexpr (IDENTITY_IDS) {
+      return _graph.id(n);
+    } else {
+      return _node_id[n];
+    }
+  }
+
+  // Internal index of the arc a
+  inline int arcIndex(const Arc &a) const {
+    if constexpr (IDENTITY_IDS) {
+      return _arc_begin + _graph.id(a);
+    } else {
+      return _arc_id[a];
+    }
+  }
+
+  // Cost of the internal arc e
+  inline Cost arcCost(const int e) const {
+    return e < _arc_begin || !_implicit_cost
+               ? _cost[e]
+               : _cost_table[_cost_key[_source[e]] - _cost_key[_target[e]]];
+  }
+
+  // Raw views of the arrays used in pricing, which move on resize
+  inline utils::PricingArrays<Cost> pricingArrays() const {
+    utils::PricingArrays<Cost> a{_state.data(), _source.data(),
+                                 _target.data(), _cost.data(), _pi.data()};
+    if (_implicit_cost) {
+      a.key = _cost_key.data();
+      a.table = _cost_table;
+      a.implicit_begin = _arc_begin;
+    }
+    return a;
+  }
+
+  // Copies the cost table keys of the nodes, the root has no real arcs
+  void initCostKeys() {
+    const auto &keys = _graph.costKeys();
+    _cost_key.assign(_node_num + 1, 0);
+    for (int i = 0; i != _node_num; ++i) {
+      _cost_key[i] = keys[_graph.id(_node[i])];
+    }
+  }
+
   // Update potentials in the subtree that has been moved
   void updatePotential() {
-    Cost sigma = _pi[v_in] - _pi[u_in] - _pred_dir[u_in] * _cost[in_arc];
+    Cost sigma = _pi[v_in] - _pi[u_in] - _pred_dir[u_in] * arcCost(in_arc);
     int end = _thread[_last_succ[u_in]];
     for (int u = u_in; u != end; u = _thread[u]) {
       _pi[u] += sigma;
@@ -1964,9 +2444,12 @@ class UlmNetworkSimplex {
   // Heuristic initial pivots
   bool initialPivots() {
     Value curr, total = 0;
-    std::vector<Node> supply_nodes, demand_nodes;
+    std::vector<Node> &supply_nodes = _scratch.supply_nodes,
+                      &demand_nodes = _scratch.demand_nodes;
+    supply_nodes.clear();
+    demand_nodes.clear();
     for (NodeIt u(_graph); u != INVALID; ++u) {
-      curr = _supply[_node_id[u]];
+      curr = _supply[nodeIndex(u)];
       if (curr > 0) {
         total += curr;
         supply_nodes.push_back(u);
@@ -1977,13 +2460,15 @@ class UlmNetworkSimplex {
     if (_sum_supply > 0) total -= _sum_supply;
     if (total <= 0) return true;
 
-    IntVector arc_vector;
+    IntVector &arc_vector = _scratch.arc_vector;
+    arc_vector.clear();
     if (_sum_supply >= 0) {
       if (supply_nodes.size() == 1 && demand_nodes.size() == 1) {
         // Perform a reverse graph search from the sink to the source
         typename GR::template NodeMap<bool> reached(_graph, false);
         Node s = supply_nodes[0], t = demand_nodes[0];
-        std::vector<Node> stack;
+        std::vector<Node> &stack = _scratch.node_stack;
+        stack.clear();
         reached[t] = true;
         stack.push_back(t);
         while (!stack.empty()) {
@@ -1992,8 +2477,8 @@ class UlmNetworkSimplex {
           if (v == s) break;
           for (InArcIt a(_graph, v); a != INVALID; ++a) {
             if (reached[u = _graph.source(a)]) continue;
-            int j = _arc_id[a];
-            if (_cap[j] >= total) {
+            int j = arcIndex(a);
+            if (capacity(j) >= total) {
               arc_vector.push_back(j);
               reached[u] = true;
               stack.push_back(u);
@@ -2007,14 +2492,14 @@ class UlmNetworkSimplex {
           Cost c, min_cost = std::numeric_limits<Cost>::max();
           Arc min_arc = INVALID;
           for (InArcIt a(_graph, v); a != INVALID; ++a) {
-            c = _cost[_arc_id[a]];
+            c = arcCost(arcIndex(a));
             if (c < min_cost) {
               min_cost = c;
               min_arc = a;
             }
           }
           if (min_arc != INVALID) {
-            arc_vector.push_back(_arc_id[min_arc]);
+            arc_vector.push_back(arcIndex(min_arc));
           }
         }
       }
@@ -2025,14 +2510,14 @@ class UlmNetworkSimplex {
         Cost c, min_cost = std::numeric_limits<Cost>::max();
         Arc min_arc = INVALID;
         for (OutArcIt a(_graph, u); a != INVALID; ++a) {
-          c = _cost[_arc_id[a]];
+          c = arcCost(arcIndex(a));
           if (c < min_cost) {
             min_cost = c;
             min_arc = a;
           }
         }
         if (min_arc != INVALID) {
-          arc_vector.push_back(_arc_id[min_arc]);
+          arc_vector.push_back(arcIndex(min_arc));
         }
       }
     }
@@ -2041,7 +2526,7 @@ class UlmNetworkSimplex {
     for (int i = 0; i != int(arc_vector.size()); ++i) {
       in_arc = arc_vector[i];
       if (_state[in_arc] *
-              (_cost[in_arc] + _pi[_source[in_arc]] - _pi[_target[in_arc]]) >=
+              (arcCost(in_arc) + _pi[_source[in_arc]] - _pi[_target[in_arc]]) >=
           0)
         continue;
       findJoinNode();
@@ -2076,21 +2561,35 @@ class UlmNetworkSimplex {
     return INFEASIBLE;  // avoid warning
   }
 
+  // Resets the statistics for a new run
+  void startStatistics() {
+    _stats = ST();
+    _stats.start(static_cast<double>(_arc_num) / _graph.redNum() /
+                 _graph.blueNum());
+  }
+
   template <typename PivotRuleImpl>
   ProblemType start() {
     PivotRuleImpl pivot(*this);
 
     // Perform heuristic initial pivots
-    if (!initialPivots()) return UNBOUNDED;
+    if (!_warm_started && !initialPivots()) return UNBOUNDED;
 
     // Execute the Network Simplex algorithm
-    while (pivot.findEnteringArc()) {
+    for (;;) {
+      {
+        StatsScope pricing_scope(_stats, utils::PHASE_PRICING);
+        if (!pivot.findEnteringArc()) break;
+      }
+      StatsScope tree_scope(_stats, utils::PHASE_TREE_UPDATE);
       findJoinNode();
       bool change = findLeavingArc();
       if (delta >= MAX) return UNBOUNDED;
+      _stats.pivot(delta == 0);
       changeFlow(change);
       if (change) {
         updateTreeStructure();
+        StatsScope potential_scope(_stats, utils::PHASE_POTENTIAL_UPDATE);
         updatePotential();
       }
     }
@@ -2102,10 +2601,10 @@ class UlmNetworkSimplex {
     }
 
     // Transform the solution and the supply map to the original form
-    if (_has_lower) {
+    if (CAP && _has_lower) {
       // for (int i = 0; i != _arc_num; ++i) {
       for (int i = _arc_begin; i != _arc_end; ++i) {
-        Value c = _lower[i];
+        Value c = lowerBound(i);
         if (c != 0) {
           _flow[i] += c;
           _supply[_source[i]] += c;
@@ -13,6 +13,12 @@ class NotSupportedError : public std::logic_error {
       : std::logic_error("This is not supported.") {};
 };
 
+class ArcOverflowError : public std::length_error {
+ public:
+  ArcOverflowError()
+      : std::length_error("The number of arcs exceeds the arc id range.") {};
+};
+
 };  // namespace utils
 
 };  // namespace lemon
@@ -3,6 +3,7 @@
 #ifndef ULMON_UTILS_GRID_H
 #define ULMON_UTILS_GRID_H
 
+#include <algorithm>
 #include <cassert>
 #include <limits>
 #include <vector>
@@ -15,11 +16,12 @@ namespace utils {
 // Arc and node numbers
 //
 
-// Returns number of nodes in grid
-template <typename Array>
-inline int numNodes(const Array& gridDim) {
+// Returns number of nodes in grid, Index is the type of the result, use a
+// 64-bit type to count potential arcs of large grids
+template <typename Index = int, typename Array>
+inline Index numNodes(const Array& gridDim) {
   constexpr int dim = std::tuple_size<Array>{};
-  int n = 1;
+  Index n = 1;
   for (int i = 0; i < dim; ++i) {
     n *= gridDim[i];
     assert(n >= 0);  // Overflow detection
@@ -28,10 +30,10 @@ inline int numNodes(const Array& gridDim) {
 }
 
 // Returns number of nodes in rectangle
-template <typename Array>
-inline int numNodes(const Array& min, const Array& max) {
+template <typename Index = int, typename Array>
+inline Index numNodes(const Array& min, const Array& max) {
   constexpr int dim = std::tuple_size<Array>{};
-  int n = 1;
+  Index n = 1;
   for (int i = 0; i < dim; ++i) {
     n *= std::max(max[i] - min[i], 0);
     assert(n >= 0);  // Overflow detection
@@ -39,13 +41,14 @@ inline int numNodes(const Array& min, const Array& max) {
   return n;
 }
 
-template <typename PosVector>
-inline int numArcs(const PosVector& yMin, const PosVector& yMax) {
+// Returns number of arcs in shield
+template <typename Index = int, typename PosVector>
+inline Index numArcs(const PosVector& yMin, const PosVector& yMax) {
   assert(yMin.size() == yMax.size());
   const int n = yMin.size();
-  int m = 0;
+  Index m = 0;
   for (int i = 0; i < n; ++i) {
-    m += numNodes(yMin[i], yMax[i]);
+    m += numNodes<Index>(yMin[i], yMax[i]);
     assert(m >= 0);  // Overflow detection
   }
   return m;
@@ -223,6 +226,38 @@ inline int hierarchicalDepth(const Array& gridDimX, const Array& gridDimY,
   return std::max(0, ceil_log(min, merge_num) - 1);
 }
 
+/// \brief Multilinear interpolation at the fine position \c pos of the
+/// values \c value(coarsePos) on the coarsened grid with dimensions
+/// \c coarseDim, where each coarse point sits at the center of the
+/// \c numMerge points per dimension it represents
+template <typename Array, typename F>
+inline double coarseInterpolation(const int numMerge, const Array& coarseDim,
+                                  const Array& pos, F value) {
+  constexpr int dim = std::tuple_size<Array>{};
+  Array lo{};
+  double w[dim];
+  for (int i = 0; i < dim; ++i) {
+    const double t = std::clamp((pos[i] - 0.5 * (numMerge - 1)) / numMerge,
+                                0., coarseDim[i] - 1.);
+    lo[i] = std::min(static_cast<int>(t), std::max(coarseDim[i] - 2, 0));
+    w[i] = t - lo[i];
+  }
+
+  double result = 0;
+  for (int corner = 0; corner < (1 << dim); ++corner) {
+    Array coarsePos = lo;
+    double weight = 1;
+    for (int i = 0; i < dim; ++i) {
+      const int up = corner >> i & 1;
+      coarsePos[i] += up;
+      weight *= up ? w[i] : 1 - w[i];
+    }
+    // Zero weights also cover corners outside of the grid
+    if (weight != 0) result += weight * value(coarsePos);
+  }
+  return result;
+}
+
 //
 // Min, max, less
 //
@@ -2,6 +2,7 @@
 #define ULMON_UTILS_METRIC_H
 
 #include <array>
+#include <type_traits>
 
 namespace lemon {
 
@@ -10,6 +11,9 @@ class SquaredEuclidean {
   using IntDArray = std::array<int, D>;
 
  public:
+  /// \brief Scaling both positions by s scales the distance by s^Degree
+  static constexpr int Degree = 2;
+
   inline T operator()(const IntDArray& a, const IntDArray& b) const {
     T result{0};
     for (int i = 0; i < D; ++i) {
@@ -20,6 +24,15 @@ class SquaredEuclidean {
   }
 };
 
+/// \brief Degree of homogeneity of the metric \c M, i.e. \c M::Degree if it
+/// exists and 1 otherwise
+template <typename M, typename = void>
+struct MetricDegree : std::integral_constant<int, 1> {};
+
+template <typename M>
+struct MetricDegree<M, std::void_t<decltype(M::Degree)>>
+    : std::integral_constant<int, M::Degree> {};
+
 };  // namespace lemon
 
 #endif
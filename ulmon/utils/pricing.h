@@ -0,0 +1,512 @@
+#ifndef ULMON_UTILS_PRICING_H
+#define ULMON_UTILS_PRICING_H
+
+#include <ulmon/utils/thread_pool.h>
+
+#include <algorithm>
+#include <cassert>
+#include <limits>
+#include <type_traits>
+#include <vector>
+
+#if !defined(ULMON_NO_SIMD) && defined(__GNUC__) && defined(__x86_64__)
+#define ULMON_SIMD_X86 1
+#include <immintrin.h>
+#endif
+
+namespace lemon {
+
+namespace utils {
+
+//
+// Reduced cost kernels
+//
+// All kernels evaluate the reduced cost
+//   c[e] = state[e] * (cost[e] + pi[source[e]] - pi[target[e]])
+// for the arcs e in [begin, end) of the internal arc arrays of
+// UlmNetworkSimplex. The vectorized kernels for 32-bit costs are selected at
+// runtime and return exactly the same arc as the scalar loop.
+//
+// With implicit costs, the arcs from implicit_begin on have no entry in cost.
+// Their cost only depends on the displacement of the end nodes and is
+// looked up as table[key[source[e]] - key[target[e]]], where the table and
+// the keys are small enough to stay in cache.
+//
+
+/// \brief Raw views of the arc and node arrays used in pricing
+template <typename C>
+struct PricingArrays {
+  const signed char* state;
+  const int* source;
+  const int* target;
+  const C* cost;
+  const C* pi;
+
+  // Implicit costs, see above
+  const int* key = nullptr;
+  const C* table = nullptr;
+  int implicit_begin = std::numeric_limits<int>::max();
+
+  inline C implicitCost(const int e) const {
+    return table[key[source[e]] - key[target[e]]];
+  }
+
+  inline C arcCost(const int e) const {
+    return e < implicit_begin ? cost[e] : implicitCost(e);
+  }
+
+  inline C reducedCost(const int e) const {
+    return state[e] * (arcCost(e) + pi[source[e]] - pi[target[e]]);
+  }
+
+  template <bool Implicit>
+  inline C reducedCost(const int e) const {
+    const C c = Implicit ? implicitCost(e) : cost[e];
+    return state[e] * (c + pi[source[e]] - pi[target[e]]);
+  }
+};
+
+/// \brief Calls <tt>f(b, e, std::bool_constant<implicit>{})</tt> for the
+/// nonempty parts of [begin, end) with explicit and implicit costs, in this
+/// order, and stops as soon as \c f returns \c true
+template <typename C, typename F>
+inline bool splitCostRange(const PricingArrays<C>& a, const int begin,
+                           const int end, F f) {
+  const int mid = std::clamp(a.implicit_begin, begin, end);
+  if (begin != mid && f(begin, mid, std::false_type{})) return true;
+  return mid != end && f(mid, end, std::true_type{});
+}
+
+/// \brief Instruction set extensions used by the pricing kernels
+enum class SimdLevel { SCALAR, AVX2, AVX512 };
+
+inline SimdLevel detectSimdLevel() {
+#ifdef ULMON_SIMD_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f")) return SimdLevel::AVX512;
+  if (__builtin_cpu_supports("avx2")) return SimdLevel::AVX2;
+#endif
+  return SimdLevel::SCALAR;
+}
+
+/// \brief Returns the best instruction set extension of the running cpu
+inline SimdLevel simdLevel() {
+  static const SimdLevel level = detectSimdLevel();
+  return level;
+}
+
+//
+// Scalar kernels
+//
+
+/// \brief Returns the first arc in [begin, end) with negative reduced cost,
+/// or \c end if there is none
+template <bool Implicit, typename C>
+inline int firstNegativeScalar(const PricingArrays<C>& a, int begin,
+                               const int end) {
+  for (; begin != end; ++begin) {
+    if (a.template reducedCost<Implicit>(begin) < 0) return begin;
+  }
+  return end;
+}
+
+template <typename C>
+inline int firstNegativeScalar(const PricingArrays<C>& a, const int begin,
+                               const int end) {
+  int e = end;
+  splitCostRange(a, begin, end, [&](int b, int l, auto implicit) {
+    e = firstNegativeScalar<decltype(implicit)::value>(a, b, l);
+    return e != l;
+  });
+  return e;
+}
+
+/// \brief Lowers \c min to the minimum reduced cost in [begin, end) and sets
+/// \c arg to the first arc attaining it; both stay as they are if no arc has
+/// reduced cost less than \c min
+template <bool Implicit, typename C>
+inline void minReducedCostScalar(const PricingArrays<C>& a, int begin,
+                                 const int end, C& min, int& arg) {
+  for (; begin != end; ++begin) {
+    const C c = a.template reducedCost<Implicit>(begin);
+    if (c < min) {
+      min = c;
+      arg = begin;
+    }
+  }
+}
+
+template <typename C>
+inline void minReducedCostScalar(const PricingArrays<C>& a, const int begin,
+                                 const int end, C& min, int& arg) {
+  splitCostRange(a, begin, end, [&](int b, int l, auto implicit) {
+    minReducedCostScalar<decltype(implicit)::value>(a, b, l, min, arg);
+    return false;
+  });
+}
+
+#ifdef ULMON_SIMD_X86
+
+//
+// AVX2 kernels (8 arcs per iteration)
+//
+
+template <bool Implicit>
+__attribute__((target("avx2"))) inline __m256i reducedCostAvx2(
+    const PricingArrays<int>& a, const int e) {
+  const __m256i s = _mm256_loadu_si256((const __m256i*)(a.source + e));
+  const __m256i t = _mm256_loadu_si256((const __m256i*)(a.target + e));
+  __m256i c;
+  if constexpr (Implicit) {
+    const __m256i ks = _mm256_i32gather_epi32(a.key, s, 4);
+    const __m256i kt = _mm256_i32gather_epi32(a.key, t, 4);
+    c = _mm256_i32gather_epi32(a.table, _mm256_sub_epi32(ks, kt), 4);
+  } else {
+    c = _mm256_loadu_si256((const __m256i*)(a.cost + e));
+  }
+  const __m256i st =
+      _mm256_cvtepi8_epi32(_mm_loadl_epi64((const __m128i*)(a.state + e)));
+  const __m256i ps = _mm256_i32gather_epi32(a.pi, s, 4);
+  const __m256i pt = _mm256_i32gather_epi32(a.pi, t, 4);
+  // state is -1, 0, or 1, hence sign() is the same as the product
+  return _mm256_sign_epi32(_mm256_sub_epi32(_mm256_add_epi32(c, ps), pt), st);
+}
+
+template <bool Implicit>
+__attribute__((target("avx2"))) inline int firstNegativeAvx2(
+    const PricingArrays<int>& a, int begin, const int end) {
+  for (; begin + 8 <= end; begin += 8) {
+    const __m256i c = reducedCostAvx2<Implicit>(a, begin);
+    const int mask = _mm256_movemask_ps(_mm256_castsi256_ps(c));
+    if (mask) return begin + __builtin_ctz(mask);
+  }
+  return firstNegativeScalar<Implicit>(a, begin, end);
+}
+
+inline int firstNegativeAvx2(const PricingArrays<int>& a, const int begin,
+                             const int end) {
+  int e = end;
+  splitCostRange(a, begin, end, [&](int b, int l, auto implicit) {
+    e = firstNegativeAvx2<decltype(implicit)::value>(a, b, l);
+    return e != l;
+  });
+  return e;
+}
+
+template <bool Implicit>
+__attribute__((target("avx2"))) inline void minReducedCostAvx2(
+    const PricingArrays<int>& a, int begin, const int end, int& min,
+    int& arg) {
+  if (end - begin >= 8) {
+    __m256i vmin = _mm256_set1_epi32(min);
+    __m256i varg = _mm256_set1_epi32(-1);
+    __m256i vind = _mm256_add_epi32(_mm256_set1_epi32(begin),
+                                    _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+    const __m256i step = _mm256_set1_epi32(8);
+    for (; begin + 8 <= end; begin += 8) {
+      const __m256i c = reducedCostAvx2<Implicit>(a, begin);
+      const __m256i lt = _mm256_cmpgt_epi32(vmin, c);
+      vmin = _mm256_blendv_epi8(vmin, c, lt);
+      varg = _mm256_blendv_epi8(varg, vind, lt);
+      vind = _mm256_add_epi32(vind, step);
+    }
+
+    // Each lane holds its first minimum, so the smallest arc among the lanes
+    // attaining the overall minimum is the first minimum of the range
+    alignas(32) int lmin[8], larg[8];
+    _mm256_store_si256((__m256i*)lmin, vmin);
+    _mm256_store_si256((__m256i*)larg, varg);
+    for (int l = 0; l < 8; ++l) {
+      if (larg[l] < 0) continue;
+      if (lmin[l] < min || (lmin[l] == min && larg[l] < arg)) {
+        min = lmin[l];
+        arg = larg[l];
+      }
+    }
+  }
+  minReducedCostScalar<Implicit>(a, begin, end, min, arg);
+}
+
+inline void minReducedCostAvx2(const PricingArrays<int>& a, const int begin,
+                               const int end, int& min, int& arg) {
+  splitCostRange(a, begin, end, [&](int b, int l, auto implicit) {
+    minReducedCostAvx2<decltype(implicit)::value>(a, b, l, min, arg);
+    return false;
+  });
+}
+
+//
+// AVX-512 kernels (16 arcs per iteration)
+//
+
+// Full gathers and conversions with an explicit zero source. The unmasked
+// intrinsics start from an undefined register, for which GCC emits
+// -Wmaybe-uninitialized warnings.
+__attribute__((target("avx512f"))) inline __m512i gatherAvx512(
+    const int* base, const __m512i idx) {
+  return _mm512_mask_i32gather_epi32(_mm512_setzero_si512(), 0xFFFF, idx,
+                                     base, 4);
+}
+
+template <bool Implicit>
+__attribute__((target("avx512f"))) inline __m512i reducedCostAvx512(
+    const PricingArrays<int>& a, const int e) {
+  const __m512i s = _mm512_loadu_si512((const void*)(a.source + e));
+  const __m512i t = _mm512_loadu_si512((const void*)(a.target + e));
+  __m512i c;
+  if constexpr (Implicit) {
+    const __m512i ks = gatherAvx512(a.key, s);
+    const __m512i kt = gatherAvx512(a.key, t);
+    c = gatherAvx512(a.table, _mm512_sub_epi32(ks, kt));
+  } else {
+    c = _mm512_loadu_si512((const void*)(a.cost + e));
+  }
+  const __m512i st = _mm512_maskz_cvtepi8_epi32(
+      0xFFFF, _mm_loadu_si128((const __m128i*)(a.state + e)));
+  const __m512i ps = gatherAvx512(a.pi, s);
+  const __m512i pt = gatherAvx512(a.pi, t);
+  const __m512i zero = _mm512_setzero_si512();
+  const __m512i r = _mm512_sub_epi32(_mm512_add_epi32(c, ps), pt);
+  // Negate where state is -1 and zero where state is 0
+  return _mm512_maskz_mov_epi32(
+      _mm512_test_epi32_mask(st, st),
+      _mm512_mask_sub_epi32(r, _mm512_cmplt_epi32_mask(st, zero), zero, r));
+}
+
+template <bool Implicit>
+__attribute__((target("avx512f"))) inline int firstNegativeAvx512(
+    const PricingArrays<int>& a, int begin, const int end) {
+  const __m512i zero = _mm512_setzero_si512();
+  for (; begin + 16 <= end; begin += 16) {
+    const __m512i c = reducedCostAvx512<Implicit>(a, begin);
+    const __mmask16 mask = _mm512_cmplt_epi32_mask(c, zero);
+    if (mask) return begin + __builtin_ctz(mask);
+  }
+  return firstNegativeScalar<Implicit>(a, begin, end);
+}
+
+inline int firstNegativeAvx512(const PricingArrays<int>& a, const int begin,
+                               const int end) {
+  int e = end;
+  splitCostRange(a, begin, end, [&](int b, int l, auto implicit) {
+    e = firstNegativeAvx512<decltype(implicit)::value>(a, b, l);
+    return e != l;
+  });
+  return e;
+}
+
+template <bool Implicit>
+__attribute__((target("avx512f"))) inline void minReducedCostAvx512(
+    const PricingArrays<int>& a, int begin, const int end, int& min,
+    int& arg) {
+  if (end - begin >= 16) {
+    __m512i vmin = _mm512_set1_epi32(min);
+    __m512i varg = _mm512_set1_epi32(-1);
+    __m512i vind = _mm512_add_epi32(
+        _mm512_set1_epi32(begin),
+        _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15));
+    const __m512i step = _mm512_set1_epi32(16);
+    for (; begin + 16 <= end; begin += 16) {
+      const __m512i c = reducedCostAvx512<Implicit>(a, begin);
+      const __mmask16 lt = _mm512_cmplt_epi32_mask(c, vmin);
+      vmin = _mm512_mask_mov_epi32(vmin, lt, c);
+      varg = _mm512_mask_mov_epi32(varg, lt, vind);
+      vind = _mm512_add_epi32(vind, step);
+    }
+
+    // See minReducedCostAvx2
+    alignas(64) int lmin[16], larg[16];
+    _mm512_store_si512((void*)lmin, vmin);
+    _mm512_store_si512((void*)larg, varg);
+    for (int l = 0; l < 16; ++l) {
+      if (larg[l] < 0) continue;
+      if (lmin[l] < min || (lmin[l] == min && larg[l] < arg)) {
+        min = lmin[l];
+        arg = larg[l];
+      }
+    }
+  }
+  minReducedCostScalar<Implicit>(a, begin, end, min, arg);
+}
+
+inline void minReducedCostAvx512(const PricingArrays<int>& a, const int begin,
+                                 const int end, int& min, int& arg) {
+  splitCostRange(a, begin, end, [&](int b, int l, auto implicit) {
+    minReducedCostAvx512<decltype(implicit)::value>(a, b, l, min, arg);
+    return false;
+  });
+}
+
+#endif  // ULMON_SIMD_X86
+
+//
+// Dispatching kernels
+//
+
+/// \brief Returns the first arc in [begin, end) with negative reduced cost,
+/// or \c end if there is none
+template <typename C>
+inline int firstNegative(const PricingArrays<C>& a, const int begin,
+                         const int end) {
+  return firstNegativeScalar(a, begin, end);
+}
+
+/// \brief Lowers \c min to the minimum reduced cost in [begin, end) and sets
+/// \c arg to the first arc attaining it
+template <typename C>
+inline void minReducedCost(const PricingArrays<C>& a, const int begin,
+                           const int end, C& min, int& arg) {
+  minReducedCostScalar(a, begin, end, min, arg);
+}
+
+#ifdef ULMON_SIMD_X86
+
+template <>
+inline int firstNegative<int>(const PricingArrays<int>& a, const int begin,
+                              const int end) {
+  switch (simdLevel()) {
+    case SimdLevel::AVX512:
+      return firstNegativeAvx512(a, begin, end);
+    case SimdLevel::AVX2:
+      return firstNegativeAvx2(a, begin, end);
+    default:
+      return firstNegativeScalar(a, begin, end);
+  }
+}
+
+template <>
+inline void minReducedCost<int>(const PricingArrays<int>& a, const int begin,
+                                const int end, int& min, int& arg) {
+  switch (simdLevel()) {
+    case SimdLevel::AVX512:
+      minReducedCostAvx512(a, begin, end, min, arg);
+      break;
+    case SimdLevel::AVX2:
+      minReducedCostAvx2(a, begin, end, min, arg);
+      break;
+    default:
+      minReducedCostScalar(a, begin, end, min, arg);
+  }
+}
+
+#endif  // ULMON_SIMD_X86
+
+//
+// Block search
+//
+// The arcs [next, end) followed by [begin, next) are scanned in blocks of
+// block_size arcs, where a block may wrap around. The search stops at the
+// first block whose minimum reduced cost is negative, sets arg to the first
+// arc attaining it and next to the last arc of the block, unless the block
+// is the incomplete last one.
+//
+
+/// \brief Sequential block search, see above
+template <typename C>
+inline bool blockSearch(const PricingArrays<C>& a, const int begin, int& next,
+                        const int end, const int block_size, int& arg) {
+  C min = 0;
+  int cnt = block_size;
+  const int ranges[2][2] = {{next, end}, {begin, next}};
+  for (const auto& [b, e] : ranges) {
+    for (int i = b; i != e;) {
+      const int len = std::min(cnt, e - i);
+      minReducedCost(a, i, i + len, min, arg);
+      i += len;
+      if ((cnt -= len) == 0) {
+        if (min < 0) {
+          next = i - 1;
+          return true;
+        }
+        cnt = block_size;
+      }
+    }
+  }
+  return min < 0;
+}
+
+/// \brief Parallel block search, see above
+///
+/// The first \c min_parallel_arcs arcs are searched sequentially block by
+/// block, since most searches end in the first block. Longer searches continue
+/// in rounds, in which each thread searches consecutive blocks of at least
+/// \c min_parallel_arcs arcs in total, and the first block with a negative
+/// minimum wins. Hence the result is the same as the one of the sequential
+/// block search, and each round amortizes the synchronization of the pool
+/// also for blocks of a few hundred arcs, as in the shielded pivot rule.
+///
+/// With the default of 4096, only 1% of the searches of the grid solver on
+/// random 128x128 and 256x256 instances reach the parallel rounds, but 29%
+/// and 43% of the scanned arcs, respectively, lie in them. A sweep costs 0.6
+/// to 1.2 ns per arc, so a round takes a few microseconds per thread.
+template <typename C>
+inline bool blockSearch(const PricingArrays<C>& a, const int begin, int& next,
+                        const int end, const int block_size, int& arg,
+                        ThreadPool& pool, const int min_parallel_arcs = 4096) {
+  const int threads = pool.size();
+  if (threads == 1) return blockSearch(a, begin, next, end, block_size, arg);
+
+  // Positions p in [0, len) enumerate [next, end) followed by [begin, next)
+  const int len = end - begin, head = end - next;
+  auto search = [&](const int b, const int e, C& min, int& arg) {
+    if (b < head)
+      minReducedCost(a, next + b, next + std::min(e, head), min, arg);
+    if (e > head)
+      minReducedCost(a, begin + std::max(b, head) - head, begin + e - head,
+                     min, arg);
+  };
+  // The next search starts at the last arc of the found block
+  auto found = [&](const int last) {
+    if (last < len) next = last < head ? next + last : begin + last - head;
+    return true;
+  };
+
+  // Sequential part of whole blocks
+  const int blocks = (min_parallel_arcs + block_size - 1) / block_size;
+  const int seq_len = std::min(blocks * block_size, len);
+  for (int p = 0; p < seq_len; p += block_size) {
+    C min = 0;
+    search(p, std::min(p + block_size, len), min, arg);
+    if (min < 0) return found(p + block_size - 1);
+  }
+
+  // Parallel rounds of chunk arcs per thread
+  struct alignas(64) Result {
+    C min;
+    int arg;
+    int last;  // Last position of the block of arg
+  };
+  static thread_local std::vector<Result> buffer;
+  buffer.resize(threads);
+  Result* const results = buffer.data();  // thread_local is per worker
+
+  const int chunk = std::max(blocks, 1) * block_size;
+  for (int p = seq_len; p < len; p += threads * chunk) {
+    const int num = std::min(threads, (len - p + chunk - 1) / chunk);
+    pool.run(num, [&](const int i) {
+      const int b = p + i * chunk, e = std::min(b + chunk, len);
+      Result r{0, -1, 0};
+      for (int q = b; q < e; q += block_size) {
+        search(q, std::min(q + block_size, e), r.min, r.arg);
+        if (r.min < 0) {
+          r.last = q + block_size - 1;
+          break;
+        }
+      }
+      results[i] = r;
+    });
+
+    for (int i = 0; i < num; ++i) {
+      if (results[i].min >= 0) continue;
+      arg = results[i].arg;
+      return found(results[i].last);
+    }
+  }
+  return false;
+}
+
+};  // namespace utils
+
+};  // namespace lemon
+
+#endif
@@ -0,0 +1,54 @@
+#ifndef ULMON_UTILS_RADIX_SORT_H
+#define ULMON_UTILS_RADIX_SORT_H
+
+#include <array>
+#include <cassert>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace lemon {
+
+namespace utils {
+
+/// \brief Key and value pairs sorted by \ref radixSort()
+template <typename T>
+using KeyedVector = std::vector<std::pair<std::uint64_t, T>>;
+
+/// \brief Sorts the items stably by their keys, which must be at most
+/// max_key, with a least significant digit radix sort
+///
+/// Each pass handles 8 bits of the key, so only the passes up to the highest
+/// bit of max_key are done. The scratch vector is resized as needed and may
+/// be kept to avoid allocations in later calls.
+template <typename T>
+void radixSort(KeyedVector<T>& items, KeyedVector<T>& scratch,
+               const std::uint64_t max_key) {
+  constexpr int BITS = 8;
+  constexpr int BUCKETS = 1 << BITS;
+  constexpr std::uint64_t MASK = BUCKETS - 1;
+
+  scratch.resize(items.size());
+  for (int shift = 0; shift < 64 && (max_key >> shift) > 0; shift += BITS) {
+    std::array<std::size_t, BUCKETS> first{};
+    for (const auto& item : items) {
+      assert(item.first <= max_key);
+      ++first[(item.first >> shift) & MASK];
+    }
+    std::size_t sum = 0;
+    for (std::size_t& f : first) {
+      const std::size_t n = f;
+      f = sum;
+      sum += n;
+    }
+    for (const auto& item : items)
+      scratch[first[(item.first >> shift) & MASK]++] = item;
+    items.swap(scratch);
+  }
+}
+
+};  // namespace utils
+
+};  // namespace lemon
+
+#endif
@@ -0,0 +1,30 @@
+#ifndef ULMON_UTILS_RECORD_FIELD_H
+#define ULMON_UTILS_RECORD_FIELD_H
+
+#include <vector>
+
+namespace lemon {
+
+namespace utils {
+
+/// \brief Indexed view of the member \c M of the records in a vector
+///
+/// It is used like a vector of \c T, such that code indexing separate arrays
+/// also runs on interleaved records. The view stores a pointer to the
+/// records, hence it has to be renewed after the vector reallocates.
+template <typename R, typename T, T R::*M>
+class RecordField {
+  R *_records{nullptr};
+
+ public:
+  RecordField() = default;
+  explicit RecordField(std::vector<R> &records) : _records(records.data()) {}
+
+  inline T &operator[](const int i) const { return _records[i].*M; }
+};
+
+};  // namespace utils
+
+};  // namespace lemon
+
+#endif
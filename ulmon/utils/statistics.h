@@ -0,0 +1,147 @@
+#ifndef ULMON_UTILS_STATISTICS_H
+#define ULMON_UTILS_STATISTICS_H
+
+#include <time.h>
+
+#include <array>
+#include <chrono>
+#include <vector>
+
+namespace lemon {
+
+namespace utils {
+
+/// \brief Cpu time of the calling thread in ms
+///
+/// Unlike std::clock(), it does not count the other threads of the process,
+/// e.g. other solvers running in parallel.
+inline double threadCpuMs() {
+  timespec ts;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return 1000. * ts.tv_sec + ts.tv_nsec / 1e6;
+}
+
+/// \brief Phases of a solve that are timed separately
+enum Phase {
+  PHASE_NONE = -1,
+  PHASE_PRICING,           // Entering arc search
+  PHASE_TREE_UPDATE,       // Join node, leaving arc, flow and tree update
+  PHASE_POTENTIAL_UPDATE,  // Potential update of the moved subtree
+  PHASE_SHIELD,            // Shield rebuilds and updates incl. internals
+  PHASE_REFINEMENT,        // Preparation of the next finer level
+  PHASE_NUM
+};
+
+/// \brief Statistics policy that records nothing
+///
+/// This is the default policy of \ref UlmNetworkSimplex and
+/// \ref UlmGridSolver. All its functions are empty, so the instrumentation
+/// compiles away.
+struct NoStatistics {
+  /// \brief Scope whose lifetime is attributed to a phase
+  struct Scope {
+    Scope(NoStatistics &, Phase) {}
+  };
+
+  void start(double) {}
+  void stop() {}
+  void warmStart(bool) {}
+  void pivot(bool) {}
+  void search(long) {}
+  void shieldRebuild(long, double) {}
+  void shieldUpdate(long, double) {}
+};
+
+/// \brief Statistics policy that records the statistics of one network
+/// simplex run, i.e. of one level of the grid solver
+///
+/// Times of nested scopes are exclusive, e.g. a shield rebuild triggered
+/// by the entering arc search does not count as pricing time. The wall
+/// times are per phase. The cpu time is the one of the solving thread, it
+/// covers the whole run but not the threads of the pool.
+struct SolverStatistics {
+  long pivots{0};             // Found entering arcs
+  long degenerate_pivots{0};  // Pivots that do not change the flow
+  long search_length{0};      // Arcs scanned by the entering arc searches
+  int shield_rebuilds{0};
+  int shield_updates{0};
+  long arcs_added{0};  // Arcs added by shield rebuilds and updates
+  std::vector<double> densities;  // Arc density at start and after each
+                                  // shield rebuild or update
+  std::array<double, PHASE_NUM> phase_ms{};  // Wall time per phase
+  double wall_ms{0};
+  double cpu_ms{0};
+  bool warm_start{false};  // Started from the given warm start
+
+  /// \brief Scope whose lifetime is attributed to a phase
+  class Scope {
+    SolverStatistics &_s;
+    const Phase _prev;
+
+   public:
+    Scope(SolverStatistics &s, const Phase phase) : _s(s), _prev(s._phase) {
+      _s.enter(phase);
+    }
+    ~Scope() { _s.enter(_prev); }
+  };
+
+  /// \brief Starts the wall and cpu clocks of the run and records the
+  /// initial arc density
+  void start(const double density) {
+    _wall0 = _t0 = Clock::now();
+    _cpu0 = threadCpuMs();
+    densities.push_back(density);
+  }
+
+  /// \brief Stops the wall and cpu clocks of the run
+  void stop() {
+    wall_ms += ms(Clock::now() - _wall0);
+    cpu_ms += threadCpuMs() - _cpu0;
+  }
+
+  void warmStart(const bool accepted) { warm_start = accepted; }
+
+  void pivot(const bool degenerate) {
+    ++pivots;
+    degenerate_pivots += degenerate;
+  }
+
+  void search(const long length) { search_length += length; }
+
+  void shieldRebuild(const long arcs, const double density) {
+    ++shield_rebuilds;
+    arcs_added += arcs;
+    densities.push_back(density);
+  }
+
+  void shieldUpdate(const long arcs, const double density) {
+    ++shield_updates;
+    arcs_added += arcs;
+    densities.push_back(density);
+  }
+
+ private:
+  using Clock = std::chrono::steady_clock;
+
+  Phase _phase{PHASE_NONE};
+  Clock::time_point _t0, _wall0;
+  double _cpu0{0};
+
+  static double ms(const Clock::duration d) {
+    return std::chrono::duration<double, std::milli>(d).count();
+  }
+
+  // Charges the time since the last switch to the current phase
+  void enter(const Phase phase) {
+    const Clock::time_point t = Clock::now();
+    if (_phase != PHASE_NONE) phase_ms[_phase] += ms(t - _t0);
+    _phase = phase;
+    _t0 = t;
+  }
+};
+
+};  // namespace utils
+
+};  // namespace lemon
+
+#endif
@@ -0,0 +1,157 @@
+#ifndef ULMON_UTILS_THREAD_POOL_H
+#define ULMON_UTILS_THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+namespace lemon {
+
+namespace utils {
+
+/// \brief Persistent pool of worker threads for fine grained fork-join loops
+///
+/// \ref run() executes a loop body on the calling thread and the workers and
+/// returns once all iterations are done. Workers spin for a short while after
+/// each loop before they go to sleep, since the network simplex calls the pool
+/// once per pivot with only a few microseconds of sequential work in between.
+/// A pool must only be used by one thread at a time.
+class ThreadPool {
+  // Busy waiting rounds before yielding and before a worker goes to sleep
+  constexpr static int PAUSE_COUNT = 1 << 6;
+  constexpr static int SPIN_COUNT = 1 << 14;
+
+  std::vector<std::thread> _workers;
+
+  // Current loop, the body is called through a trampoline instead of a
+  // std::function, which would allocate on each run()
+  void (*_call)(void *, int){nullptr};
+  void *_body{nullptr};
+  int _n{0};
+  std::atomic<int> _next{0};
+  std::atomic<int> _finished{0};
+
+  // Each call of run() is a generation, _stop ends all workers
+  std::atomic<unsigned> _generation{0};
+  bool _stop{false};
+  std::mutex _mutex;
+  std::condition_variable _cv;
+
+ public:
+  /// \brief Constructs a pool with \c num_threads threads including the
+  /// calling thread, i.e. with <tt>num_threads - 1</tt> workers
+  explicit ThreadPool(
+      const int num_threads = std::thread::hardware_concurrency()) {
+    for (int i = 1; i < num_threads; ++i) {
+      _workers.emplace_back([this] { work(); });
+    }
+  }
+
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+
+  ~ThreadPool() {
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _stop = true;
+      _generation.fetch_add(1, std::memory_order_release);
+    }
+    _cv.notify_all();
+    for (std::thread &t : _workers) t.join();
+  }
+
+  /// \brief Number of threads including the calling thread
+  int size() const { return static_cast<int>(_workers.size()) + 1; }
+
+  /// \brief Calls <tt>body(i)</tt> for all \c i in [0, n) in parallel
+  ///
+  /// Iterations are handed out one by one in increasing order, so expensive
+  /// bodies should cover a range of indices each.
+  template <typename F>
+  void run(const int n, F &&body) {
+    if (_workers.empty() || n <= 1) {
+      for (int i = 0; i < n; ++i) body(i);
+      return;
+    }
+
+    _call = &call<std::remove_reference_t<F>>;
+    _body = const_cast<void *>(static_cast<const void *>(&body));
+    _n = n;
+    _next.store(0, std::memory_order_relaxed);
+    _finished.store(0, std::memory_order_relaxed);
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _generation.fetch_add(1, std::memory_order_release);
+    }
+    _cv.notify_all();
+
+    process();
+
+    // Wait until every worker has left this generation, so that the next
+    // call may safely overwrite the loop data
+    const int num_workers = static_cast<int>(_workers.size());
+    for (int spin = 0;
+         _finished.load(std::memory_order_acquire) != num_workers; ++spin) {
+      pause(spin);
+    }
+  }
+
+ private:
+  // Yields after a few rounds in case the threads oversubscribe the cores
+  static inline void pause(const int spin) {
+#if defined(__GNUC__) && defined(__x86_64__)
+    if (spin < PAUSE_COUNT) {
+      _mm_pause();
+      return;
+    }
+#endif
+    std::this_thread::yield();
+  }
+
+  template <typename F>
+  static void call(void *body, const int i) {
+    (*static_cast<F *>(body))(i);
+  }
+
+  inline void process() {
+    for (int i; (i = _next.fetch_add(1, std::memory_order_relaxed)) < _n;) {
+      _call(_body, i);
+    }
+  }
+
+  void work() {
+    unsigned seen = 0;
+    for (;;) {
+      // Busy wait for the next generation, then sleep
+      int spin = 0;
+      while (_generation.load(std::memory_order_acquire) == seen) {
+        if (++spin < SPIN_COUNT) {
+          pause(spin);
+          continue;
+        }
+        std::unique_lock<std::mutex> lock(_mutex);
+        _cv.wait(lock, [&] {
+          return _generation.load(std::memory_order_acquire) != seen;
+        });
+      }
+      seen = _generation.load(std::memory_order_acquire);
+      if (_stop) return;
+
+      process();
+      _finished.fetch_add(1, std::memory_order_release);
+    }
+  }
+};
+
+};  // namespace utils
+
+};  // namespace lemon
+
+#endif
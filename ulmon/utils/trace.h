@@ -0,0 +1,147 @@
+#ifndef ULMON_UTILS_TRACE_H
+#define ULMON_UTILS_TRACE_H
+
+#include <atomic>
+#include <chrono>
+#include <fmt/printf.hpp>
+#include <fstream>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace lemon {
+
+namespace utils {
+
+/// \brief Collects timed scopes of all threads and writes them in the Chrome
+/// trace event format
+///
+/// The output can be opened in chrome://tracing or https://ui.perfetto.dev.
+/// Scopes are recorded by \ref TraceScope, usually via the macro
+/// \ref ULMON_TRACE_SCOPE, which is empty unless \c ULMON_TRACE is defined.
+/// Event and argument names must be string literals without characters that
+/// need escaping in JSON.
+class Tracer {
+  using Clock = std::chrono::steady_clock;
+
+  struct Event {
+    const char *name;
+    const char *arg_name;
+    long arg;
+    int tid;
+    double ts, dur;  // In microseconds
+  };
+
+  const Clock::time_point _epoch{Clock::now()};
+  std::vector<Event> _events;
+  mutable std::mutex _mutex;
+
+ public:
+  /// \brief Returns the global tracer
+  static Tracer &instance() {
+    static Tracer tracer;
+    return tracer;
+  }
+
+  /// \brief Microseconds since the construction of the tracer
+  double now() const {
+    return std::chrono::duration<double, std::micro>(Clock::now() - _epoch)
+        .count();
+  }
+
+  /// \brief Records a complete event, \c arg_name may be \c nullptr
+  void record(const char *name, const char *arg_name, const long arg,
+              const double ts, const double dur) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _events.push_back({name, arg_name, arg, threadId(), ts, dur});
+  }
+
+  /// \brief Removes all recorded events
+  void clear() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _events.clear();
+  }
+
+  /// \brief Number of recorded events
+  std::size_t size() const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _events.size();
+  }
+
+  /// \brief Writes all recorded events as JSON object
+  void write(std::ostream &os) const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    os << "{\"traceEvents\":[";
+    for (std::size_t i = 0; i < _events.size(); ++i) {
+      const Event &e = _events[i];
+      fmt::printf(os,
+                  "%s\n{\"name\":\"%s\",\"cat\":\"ulmon\",\"ph\":\"X\","
+                  "\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f",
+                  i ? "," : "", e.name, e.tid, e.ts, e.dur);
+      if (e.arg_name)
+        fmt::printf(os, ",\"args\":{\"%s\":%d}", e.arg_name, e.arg);
+      os << "}";
+    }
+    os << "\n],\"displayTimeUnit\":\"ms\"}\n";
+  }
+
+  /// \brief Writes all recorded events into the file \c filename
+  void write(const std::string &filename) const {
+    std::ofstream file(filename);
+    write(file);
+  }
+
+ private:
+  Tracer() { _events.reserve(1 << 12); }
+
+  // Small consecutive ids, the first tracing thread gets 0
+  static int threadId() {
+    static std::atomic<int> next{0};
+    thread_local const int id = next++;
+    return id;
+  }
+};
+
+/// \brief Records the lifetime of the object as trace event
+class TraceScope {
+  const char *_name;
+  const char *_arg_name;
+  const long _arg;
+  const double _ts;
+
+ public:
+  explicit TraceScope(const char *name, const char *arg_name = nullptr,
+                      const long arg = 0)
+      : _name(name),
+        _arg_name(arg_name),
+        _arg(arg),
+        _ts(Tracer::instance().now()) {}
+
+  TraceScope(const TraceScope &) = delete;
+  TraceScope &operator=(const TraceScope &) = delete;
+
+  ~TraceScope() {
+    Tracer &tracer = Tracer::instance();
+    tracer.record(_name, _arg_name, _arg, _ts, tracer.now() - _ts);
+  }
+};
+
+};  // namespace utils
+
+};  // namespace lemon
+
+#define ULMON_TRACE_CONCAT_(a, b) a##b
+#define ULMON_TRACE_CONCAT(a, b) ULMON_TRACE_CONCAT_(a, b)
+
+/// \brief Traces the rest of the enclosing block, takes an event name and
+/// optionally an argument name and an integer argument
+#ifdef ULMON_TRACE
+#define ULMON_TRACE_SCOPE(...)                                      \
+  const ::lemon::utils::TraceScope ULMON_TRACE_CONCAT(_trace_scope_, \
+                                                      __LINE__)(__VA_ARGS__)
+#else
+#define ULMON_TRACE_SCOPE(...) static_cast<void>(0)
+#endif
+
+#endif
@@ -0,0 +1,46 @@
+#ifndef ULMON_UTILS_VIEW_H
+#define ULMON_UTILS_VIEW_H
+
+#include <cassert>
+#include <cstddef>
+#include <vector>
+
+namespace lemon {
+
+namespace utils {
+
+/// \brief Non-owning read-only view of a contiguous array
+///
+/// It stores a pointer and a length, so buffers owned by the caller, e.g.
+/// images, mapped files, or arrays of another language, are read without a
+/// copy. The viewed memory must outlive the view, hence temporary vectors
+/// cannot be viewed.
+template <typename T>
+class ConstView {
+  const T *_data{nullptr};
+  std::size_t _size{0};
+
+ public:
+  ConstView() = default;
+  ConstView(const T *data, const std::size_t size)
+      : _data(data), _size(size) {}
+  ConstView(const std::vector<T> &v) : _data(v.data()), _size(v.size()) {}
+  // A temporary vector would be freed while the view is still in use
+  ConstView(std::vector<T> &&) = delete;
+
+  inline const T *data() const { return _data; }
+  inline std::size_t size() const { return _size; }
+  inline const T *begin() const { return _data; }
+  inline const T *end() const { return _data + _size; }
+
+  inline const T &operator[](const std::size_t i) const {
+    assert(i < _size);
+    return _data[i];
+  }
+};
+
+};  // namespace utils
+
+};  // namespace lemon
+
+#endif